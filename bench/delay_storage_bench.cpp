@@ -0,0 +1,142 @@
+/**
+ * \file delay_storage_bench.cpp
+ *
+ * \brief Compares the delay line storage formats of delay_storage.h in speed and quality.
+ *
+ * \details One output channel of the diffuse model (numcombs comb_filter and numallpasses allpass_filter instances tuned as in tuning.h) is rendered for every storage format. The input is a noise burst followed by silence, so the reverb tail is part of the measurement. The float_storage render is the reference, the noise floor of the compact formats is the level of their difference to the reference relative to the reference level. The speed is measured with numChannels independent channels, so the delay lines exceed the caches the same way they do in the plugin at high orders.
+ *
+ * Usage: reverb_storage_bench [numChannels] [seconds]
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "comb_filter.h"
+#include "allpass_filter.h"
+#include "tuning.h"
+
+namespace
+{
+    const double sampleRate = 48000.0;
+
+    /// \brief One output channel of the diffuse model with delay lines in the format given by Storage
+    template <typename Storage>
+    struct diffuse_channel{
+        basic_comb_filter<Storage> comb[numcombs];
+        basic_allpass_filter<Storage> allpass[numallpasses];
+
+        explicit diffuse_channel(int channel){
+            const float feedback = (initialroom*scalefeedback) + offsetfeedback;
+            const float comb_buffactor = 1 + (initialroom*scale_comb_buffer)-(scale_comb_buffer/2);
+            const float allpass_buffactor = 1 + (initialroom*scale_allpass_buffer)-(scale_allpass_buffer/2);
+            for (int j = 0; j < numcombs; j++){
+                const int size = (int) ((channel*spreadvalue) + comb_buffer_tuning[j]*comb_buffactor);
+                comb[j].initBuffer(size);
+                comb[j].setbuffer(size);
+                comb[j].setfeedback(feedback);
+                comb[j].setdamp(initialdamp);
+            }
+            for (int j = 0; j < numallpasses; j++){
+                const int size = (int) ((channel*spreadvalue) + allpass_buffer_tuning[j]*allpass_buffactor);
+                allpass[j].initBuffer(size);
+                allpass[j].setbuffer(size);
+                allpass[j].setfeedback(feedback);
+            }
+        }
+
+        inline float process(float input){
+            float out = 0.f;
+            for (int j = 0; j < numcombs; j++) out += comb[j].process(input);
+            for (int j = 0; j < numallpasses; j++) out = allpass[j].process(out);
+            return out / numcombs;
+        }
+    };
+
+    struct result{
+        double nsPerSample;
+        std::vector<float> output;
+    };
+
+    template <typename Storage>
+    result run(const std::vector<float>& input, int numChannels){
+        std::vector<diffuse_channel<Storage>*> channels;
+        for (int i = 0; i < numChannels; i++) channels.push_back(new diffuse_channel<Storage>(i));
+
+        result res;
+        res.output.resize(input.size());
+        const int blockSize = 512;
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t blockStart = 0; blockStart < input.size(); blockStart += blockSize){
+            const size_t blockEnd = std::min(input.size(), blockStart + blockSize);
+            for (int i = 0; i < numChannels; i++){
+                diffuse_channel<Storage>& channel = *channels[i];
+                for (size_t sample = blockStart; sample < blockEnd; sample++){
+                    const float out = channel.process(input[sample]);
+                    // the first channel is the one compared against the reference
+                    if (i == 0) res.output[sample] = out;
+                }
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        res.nsPerSample = std::chrono::duration<double, std::nano>(end - start).count() / ((double) input.size() * numChannels);
+        for (auto channel : channels) delete channel;
+        return res;
+    }
+
+    double levelDb(const std::vector<float>& signal){
+        double energy = 0.0;
+        for (float sample : signal) energy += (double) sample * sample;
+        return 10.0 * std::log10(energy / signal.size() + 1e-30);
+    }
+
+    double noiseFloorDb(const std::vector<float>& reference, const std::vector<float>& signal){
+        std::vector<float> difference(reference.size());
+        for (size_t i = 0; i < reference.size(); i++) difference[i] = signal[i] - reference[i];
+        return levelDb(difference) - levelDb(reference);
+    }
+
+    void report(const char* name, const result& res, const result& reference){
+        std::printf("%-8s %10.2f ns/sample %8.2fx", name, res.nsPerSample, reference.nsPerSample / res.nsPerSample);
+        if (&res == &reference) std::printf("%16s\n", "reference");
+        else std::printf("%12.1f dB noise floor\n", noiseFloorDb(reference.output, res.output));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int numChannels = argc > 1 ? std::atoi(argv[1]) : 63;
+    const double seconds = argc > 2 ? std::atof(argv[2]) : 4.0;
+
+    // 100 ms noise burst followed by the tail
+    std::vector<float> input((size_t) (seconds * sampleRate), 0.f);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+    for (size_t i = 0; i < (size_t) (0.1 * sampleRate) && i < input.size(); i++) input[i] = noise(rng);
+
+    std::printf("%d channels, %.1f s at %.0f Hz\n", numChannels, seconds, sampleRate);
+#if defined(__F16C__)
+    std::printf("half floats converted with F16C\n");
+#else
+    std::printf("half floats converted in software\n");
+#endif
+
+    const result reference = run<float_storage>(input, numChannels);
+    const result half = run<half_storage>(input, numChannels);
+    const result int16 = run<int16_storage>(input, numChannels);
+
+    report("float", reference, reference);
+    report("half", half, reference);
+    report("int16", int16, reference);
+
+    return 0;
+}
@@ -0,0 +1,735 @@
+/**
+ * \file golden_render.cpp
+ *
+ * \brief Guards the sound of the diffuse model of the plugin against a plain reference implementation.
+ *
+ * \details A fixed set of scenarios (impulse, noise bursts, sine sweep, room size and dampening automation, a freeze held through the recording and playback of its loop and released again, a step to the lowest quality tier and back, the reduced detail profile at order 4) is rendered through two paths:
+ *  - the reference path, float delay lines processed sample by sample for all channels in the order of the original processBlock, without kernels or tiling,
+ *  - the optimized path, the diffuse_model the plugin runs (source/diffuse_model.h) with the delay line format and interpolation the plugin is built with, driven block by block with the calls of AudioPluginAudioProcessor::processBlock, with the kernels of every instruction set the CPU supports. The stage by stage processing used with the performance counters (see source/perf_counters.h) is rendered with the kernels of the detected instruction set as well.
+ *
+ * Both paths are driven in host blocks of several sizes with the parameter changes applied between blocks. Every output channel is compared by its largest sample difference relative to the reference peak and by the log spectral distance of the two signals. The tolerances depend on the delay line format, float delay lines have to match exactly. Scenarios that change the quality tier are also rendered at the full tier, and the level around every change has to stay within maxTierLevelErrorDb of it.
+ *
+ * The optimized path runs in a realtime_check::ScopedRealtimeSection, so the program aborts with a stack trace if it allocates, locks or blocks while the parameters are automated.
+ *
+ * Both paths share the comb_filter and allpass_filter classes, so a change of the filters themselves is only found by the fixtures in bench/golden: renders of every scenario at order 1 (or at the order the scenario is set to), committed to the repository and checked on every run with the largest sample difference. They hold every 32nd sample of all channels, which keeps them small while any change of a delay line still shows up in the following samples. The fixtures were rendered with float delay lines and linear interpolation, builds with another interpolation skip them, and builds with compact delay lines compare them with the tolerance of their format. --write-fixtures renders them again after an intended change of the sound.
+ *
+ * With --record the optimized renders are written to a directory, with --compare they are checked against such a recording, so that the sound of one build can be compared to the one of an older build. The recordings and fixtures are stored as raw little-endian float32 with a small header.
+ *
+ * Usage: reverb_golden [--order n] [--record dir] [--compare dir] [--fixtures dir] [--write-fixtures dir] [--verbose]
+ *
+ * The exit code is 0 if all comparisons are within the tolerances and 1 otherwise.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "comb_filter.h"
+#include "allpass_filter.h"
+#include "diffuse_kernels.h"
+#include "diffuse_model.h"
+#include "tuning.h"
+#include "realtime_check.h"
+
+namespace
+{
+    const double sampleRate = 48000.0;
+    const int numInputs = 2;
+    /// the block size of the recordings and fixtures
+    const int recordingBlockSize = 512;
+    /// ambisonic order of the fixtures
+    const int fixtureOrder = 1;
+    /// the fixtures hold every fixtureStep-th sample
+    const int fixtureStep = 32;
+
+    //==============================================================================
+    /// \brief A parameter change at a sample position, applied at the start of the host block containing it
+    struct event{
+        enum type_t { room, damp, freeze, tier };
+        int position;
+        type_t type;
+        float value;
+    };
+
+    struct scenario{
+        std::string name;
+        std::vector<std::vector<float>> input;
+        std::vector<event> events;
+        /// detail profile set before prepareToPlay
+        const int* detailCombs = detail_profile_combs;
+        const int* detailAllpasses = detail_profile_allpasses;
+        /// ambisonic order of all renders and the fixture, -1 renders at the order of the options and at fixtureOrder
+        int order = -1;
+    };
+
+    std::vector<scenario> makeScenarios(){
+        const int length = (int) (2.0 * sampleRate);
+        // from the raw generator output, std::uniform_real_distribution differs between standard libraries and would change the fixtures
+        std::mt19937 rng(7);
+        auto noise = [&](){ return (float) ((double) rng() / 4294967296.0 - 0.5); };
+        auto silence = [&](int samples){ return std::vector<std::vector<float>>(numInputs, std::vector<float>(samples, 0.f)); };
+        auto burst = [&](std::vector<std::vector<float>>& input, int start, int duration){
+            for (auto& channel : input)
+                for (int i = start; i < std::min((int) channel.size(), start + duration); i++) channel[i] = noise();
+        };
+
+        std::vector<scenario> scenarios;
+
+        scenario impulse{"impulse", silence(length), {}};
+        impulse.input[0][0] = 1.f;
+        scenarios.push_back(impulse);
+
+        scenario bursts{"noise_bursts", silence(length), {}};
+        burst(bursts.input, 0, (int) (0.1 * sampleRate));
+        burst(bursts.input, (int) sampleRate, (int) (0.05 * sampleRate));
+        scenarios.push_back(bursts);
+
+        // exponential sweep from 20 Hz to 20 kHz at -6 dBFS
+        scenario sweep{"sweep", silence(length), {}};
+        const double rate = std::log(20000.0 / 20.0);
+        for (int i = 0; i < length; i++){
+            const double t = i / (double) length;
+            const double phase = 2.0 * M_PI * 20.0 * (length / sampleRate) / rate * (std::exp(t * rate) - 1.0);
+            sweep.input[0][i] = sweep.input[1][i] = (float) (0.5 * std::sin(phase));
+        }
+        scenarios.push_back(sweep);
+
+        scenario automation{"room_automation", silence(length), {{(int) (0.25 * sampleRate), event::room, 0.9f}, {(int) (0.5 * sampleRate), event::damp, 0.7f},
+                                                           {(int) (0.75 * sampleRate), event::room, 0.2f}, {(int) (1.0 * sampleRate), event::damp, 0.1f},
+                                                           {(int) (1.25 * sampleRate), event::room, 0.75f}}};
+        burst(automation.input, 0, (int) (1.5 * sampleRate));
+        scenarios.push_back(automation);
+
+        // held until the loop is recorded and played around more than once, with a burst after the release that has to start a fresh tail
+        const float freezeHold = freeze_loop_length * 1.5f + freeze_crossfade_length;
+        scenario freeze{"freeze", silence((int) ((freezeHold + 1.5f) * sampleRate)),
+                        {{(int) (0.3 * sampleRate), event::freeze, 1.f}, {(int) ((0.3f + freezeHold) * sampleRate), event::freeze, 0.f}}};
+        burst(freeze.input, 0, (int) (0.5 * sampleRate));
+        burst(freeze.input, (int) ((0.5f + freezeHold) * sampleRate), (int) (0.1 * sampleRate));
+        scenarios.push_back(freeze);
+
+        // the lowest tier and back under steady noise, with a room size change while the combs are dropped
+        scenario tiers{"quality_tiers", silence(length), {{(int) (0.5 * sampleRate), event::tier, (float) (numqualitytiers - 1)},
+                                                         {(int) (0.8 * sampleRate), event::room, 0.4f}, {(int) (1.3 * sampleRate), event::tier, 0.f}}};
+        burst(tiers.input, 0, length);
+        scenarios.push_back(tiers);
+
+        // the reduced detail profile drops combs from order 3 and allpasses from order 4 on, the room size changes with filters dropped
+        scenario detail{"reduced_detail", silence((int) sampleRate), {{(int) (0.5 * sampleRate), event::room, 0.3f}}, reduced_detail_combs, reduced_detail_allpasses, 4};
+        burst(detail.input, 0, (int) (0.1 * sampleRate));
+        scenarios.push_back(detail);
+
+        return scenarios;
+    }
+
+    //==============================================================================
+    /// \brief SN3D normalization of an ACN channel relative to ACN0
+    float sn3d(int acn){
+        const int degree = (int) std::sqrt((double) acn);
+        const int order = std::abs(acn - degree * degree - degree);
+        double ratio = 1.0;
+        for (int k = degree - order + 1; k <= degree + order; k++) ratio /= k;
+        return (float) std::sqrt((order == 0 ? 1.0 : 2.0) * ratio);
+    }
+
+    /// \brief Plain reference implementation of the diffuse model with the parameter handling of AudioPluginAudioProcessor, float delay lines processed one sample after the other
+    struct reference_model{
+        using comb_type = basic_comb_filter<float_storage, delay_interpolation>;
+        using allpass_type = basic_allpass_filter<float_storage, delay_interpolation>;
+
+        int numOutputChannels;
+        std::vector<std::vector<comb_type>> comb;
+        std::vector<std::vector<allpass_type>> allpass;
+        std::vector<float> ACN_normalization;
+        float sum_ACN_normalization = 0.f;
+        float gain = initialgain, wet_factor = initialwet / numcombs, dry = initialdry;
+        float feedback = 0.f, damp = initialdamp;
+        float newroom = initialroom, oldroom = initialroom;
+        bool freezemode = initialfreeze;
+        /// the frozen tail of every channel, the crossfade into its start and the samples since the freeze started
+        const int loopLength = std::max(1, (int) (freeze_loop_length * sampleRate));
+        std::vector<std::vector<float>> loop;
+        std::vector<float> loopFade;
+        int freezeSamples = 0;
+        /// filters per channel and their gain compensation, now and before the last tier change, and the fade between them
+        std::vector<int> activeCombs, activeAllpasses, fadeCombs, fadeAllpasses;
+        std::vector<float> compensation, fadeCompensation;
+        std::vector<float> tierFade;
+        int tierFadeRemaining = 0;
+        const int* profileCombs;
+        const int* profileAllpasses;
+
+        reference_model(int numOutputChannels, const int* detailCombs, const int* detailAllpasses) : numOutputChannels(numOutputChannels),
+            comb(numOutputChannels - 1, std::vector<comb_type>(numcombs)), allpass(numOutputChannels - 1, std::vector<allpass_type>(numallpasses)),
+            loop(numOutputChannels - 1, std::vector<float>(loopLength)),
+            loopFade(std::clamp((int) (freeze_crossfade_length * sampleRate), 1, loopLength)),
+            activeCombs(numOutputChannels - 1, numcombs), activeAllpasses(numOutputChannels - 1, numallpasses), fadeCombs(activeCombs), fadeAllpasses(activeAllpasses),
+            compensation(numOutputChannels - 1, 1.f), fadeCompensation(compensation), tierFade(std::max(1, (int) (quality_tier_fade_length * sampleRate))),
+            profileCombs(detailCombs), profileAllpasses(detailAllpasses){
+            const float max_comb_buffactor = 1 + (scale_comb_buffer)-(scale_comb_buffer/2);
+            const float max_allpass_buffactor = 1 + (scale_allpass_buffer)-(scale_allpass_buffer/2);
+            for (int i = 0; i < numOutputChannels - 1; i++){
+                for (int j = 0; j < numcombs; j++) comb[i][j].initBuffer((int) ((i*spreadvalue) + (comb_buffer_tuning[j]*max_comb_buffactor)));
+                for (int j = 0; j < numallpasses; j++) allpass[i][j].initBuffer((int) ((i*spreadvalue) + (allpass_buffer_tuning[j]*max_allpass_buffactor)));
+            }
+            for (int i = 0; i < numOutputChannels; i++){
+                ACN_normalization.push_back(sn3d(i));
+                sum_ACN_normalization += ACN_normalization.back();
+            }
+            for (size_t i = 0; i < loopFade.size(); i++) loopFade[i] = std::sin(0.5f * (float) M_PI * ((float) i + 0.5f) / (float) loopFade.size());
+            for (size_t i = 0; i < tierFade.size(); i++) tierFade[i] = std::sin(0.5f * (float) M_PI * ((float) i + 0.5f) / (float) tierFade.size());
+            setdamp(initialdamp);
+            setroomsize(initialroom);
+            setfreezemode(initialfreeze);
+            // the detail profile is taken over without a fade, as in prepareToPlay
+            applyqualitytier(0, detailCombs, detailAllpasses);
+            tierFadeRemaining = 0;
+        }
+
+        void setroomsize(float value){
+            feedback = (value*scalefeedback) + offsetfeedback;
+            const float comb_buffactor = 1 + (value*scale_comb_buffer)-(scale_comb_buffer/2);
+            const float allpass_buffactor = 1 + (value*scale_allpass_buffer)-(scale_allpass_buffer/2);
+            for (int i = 0; i < numOutputChannels - 1; i++){
+                for (int j = 0; j < numcombs; j++){
+                    comb[i][j].setbuffer((int) ((i*spreadvalue) + comb_buffer_tuning[j]*comb_buffactor));
+                    comb[i][j].setfeedback(feedback);
+                }
+                for (int j = 0; j < numallpasses; j++){
+                    allpass[i][j].setbuffer((int) ((i*spreadvalue) + allpass_buffer_tuning[j]*allpass_buffactor));
+                    allpass[i][j].setfeedback(feedback);
+                }
+            }
+            oldroom = value;
+        }
+
+        void setdamp(float value){
+            if (value < 0.95f && value > 0.05f){
+                damp = value;
+                for (auto& combs : comb) for (auto& filter : combs) filter.setdamp(damp);
+            }
+        }
+
+        void setfreezemode(bool state){
+            freezemode = state;
+            const float feedback_filters = freezemode ? 1.f : feedback;
+            const float damp_comb = freezemode ? 0.f : damp;
+            gain = freezemode ? 0.f : initialgain;
+            if (! freezemode){
+                for (auto& combs : comb) for (auto& filter : combs) filter.mute();
+                for (auto& allpasses : allpass) for (auto& filter : allpasses) filter.mute();
+            }
+            for (auto& combs : comb){
+                for (auto& filter : combs){
+                    filter.setfeedback(feedback_filters);
+                    filter.setdamp(damp_comb);
+                }
+            }
+            for (auto& allpasses : allpass) for (auto& filter : allpasses) filter.setfeedback(feedback_filters);
+        }
+
+        /// \brief A tier change is taken over once the previous one has faded and not while frozen
+        void applyqualitytier(int tier, const int* detailCombs, const int* detailAllpasses){
+            if (tierFadeRemaining > 0 || freezemode) return;
+            for (int i = 0; i < numOutputChannels - 1; i++){
+                const int order = (int) std::sqrt((double) (i + 1));
+                const int combs = std::clamp(std::min(detailCombs[order-1], quality_tier_combs[tier][order-1]), 1, numcombs);
+                const int allpasses = std::clamp(detailAllpasses[order-1], 0, numallpasses);
+                // filters that run again start empty at their current delay, without gliding to it
+                for (int j = activeCombs[i]; j < combs; j++) comb[i][j].reset();
+                for (int j = activeAllpasses[i]; j < allpasses; j++) allpass[i][j].reset();
+                if (combs != activeCombs[i] || allpasses != activeAllpasses[i]) tierFadeRemaining = (int) tierFade.size();
+                fadeCombs[i] = activeCombs[i];
+                fadeAllpasses[i] = activeAllpasses[i];
+                fadeCompensation[i] = compensation[i];
+                activeCombs[i] = combs;
+                activeAllpasses[i] = allpasses;
+                compensation[i] = std::sqrt((float) numcombs / (float) combs);
+            }
+        }
+
+        void apply(const event& e){
+            if (e.type == event::room) newroom = e.value;
+            else if (e.type == event::damp) setdamp(e.value);
+            else if (e.type == event::freeze) setfreezemode(e.value > 0.5f);
+            else applyqualitytier((int) e.value, profileCombs, profileAllpasses);
+        }
+
+        /// \brief The room size check at the end of processBlock, dropped filters are not waited for
+        void updateRoom(){
+            if (! freezemode) freezeSamples = 0;
+            if (newroom == oldroom || freezemode) return;
+            for (int i = 0; i < numOutputChannels - 1; i++){
+                for (int j = 0; j < activeCombs[i]; j++) if (! comb[i][j].ready()) return;
+                for (int j = 0; j < activeAllpasses[i]; j++) if (! allpass[i][j].ready()) return;
+            }
+            setroomsize(newroom);
+        }
+
+        void process(const std::vector<const float*>& inputs, const std::vector<float*>& outputs, int numSamples){
+            // a tier change fades over whole blocks and ends when the freeze starts
+            if (freezemode) tierFadeRemaining = 0;
+            const bool fading = tierFadeRemaining > 0;
+            const int tierFadeLength = (int) tierFade.size();
+            const int tierFadeStart = tierFadeLength - tierFadeRemaining;
+            for (int sample = 0; sample < numSamples; sample++){
+                float in = inputs[0][sample];
+                for (int channel = 1; channel < numInputs; channel++) in += inputs[channel][sample];
+                in *= 1.f / numInputs;
+
+                float outACN0 = 0.f;
+                if (numOutputChannels < 2) outACN0 = in * (dry * ACN_normalization[0]);
+                const int fadeLength = (int) loopFade.size();
+                const bool playing = freezemode && freezeSamples >= loopLength + fadeLength;
+                const float fadeIn = tierFadeStart + sample < tierFadeLength ? tierFade[tierFadeStart + sample] : 1.f;
+                const float fadeOut = tierFadeStart + sample < tierFadeLength ? tierFade[tierFadeLength - 1 - tierFadeStart - sample] : 0.f;
+                for (int channel = 1; channel < numOutputChannels; channel++){
+                    const int i = channel - 1;
+                    float out = 0.f;
+                    if (playing) out = loop[i][(freezeSamples - loopLength) % loopLength];
+                    else if (fading){
+                        // the dropped or returning combs are faded out or in, the allpass chain is crossfaded between its output without and with them
+                        const int keptCombs = std::min(fadeCombs[i], activeCombs[i]);
+                        float changed = 0.f;
+                        for (int j = 0; j < keptCombs; j++) out += comb[i][j].process(gain * in);
+                        for (int j = keptCombs; j < std::max(fadeCombs[i], activeCombs[i]); j++) changed += comb[i][j].process(gain * in);
+                        if (fadeCombs[i] != activeCombs[i]) out += changed * (activeCombs[i] > fadeCombs[i] ? fadeIn : fadeOut);
+                        const int keptAllpasses = std::min(fadeAllpasses[i], activeAllpasses[i]);
+                        for (int j = 0; j < keptAllpasses; j++) out = allpass[i][j].process(out);
+                        if (fadeAllpasses[i] != activeAllpasses[i]){
+                            float through = out;
+                            for (int j = keptAllpasses; j < std::max(fadeAllpasses[i], activeAllpasses[i]); j++) through = allpass[i][j].process(through);
+                            out += (through - out) * (activeAllpasses[i] > fadeAllpasses[i] ? fadeIn : fadeOut);
+                        }
+                    }
+                    else {
+                        for (int j = 0; j < activeCombs[i]; j++) out += comb[i][j].process(gain * in);
+                        for (int j = 0; j < activeAllpasses[i]; j++) out = allpass[i][j].process(out);
+                    }
+                    // the frozen tail is recorded, and its end is crossfaded into the start of the loop
+                    if (freezemode && ! playing){
+                        out *= compensation[i];
+                        if (freezeSamples < loopLength) loop[i][freezeSamples] = out;
+                        else {
+                            const int fade = freezeSamples - loopLength;
+                            out = out * loopFade[fadeLength - 1 - fade] + loop[i][fade] * loopFade[fade];
+                            loop[i][fade] = out;
+                        }
+                    }
+                    if (fading) out *= wet_factor * ACN_normalization[channel] * (fadeCompensation[i] + (compensation[i] - fadeCompensation[i]) * fadeIn);
+                    else if (freezemode) out *= wet_factor * ACN_normalization[channel];
+                    else out *= wet_factor * ACN_normalization[channel] * compensation[i];
+                    outputs[channel][sample] = out;
+                    if (channel == 1) outACN0 = out * (1.f / sum_ACN_normalization) + (dry * ACN_normalization[0]) * in;
+                    else outACN0 += out * (1.f / sum_ACN_normalization);
+                }
+                outputs[0][sample] = outACN0;
+                if (freezemode) freezeSamples++;
+            }
+            if (fading) tierFadeRemaining = std::max(0, tierFadeRemaining - numSamples);
+        }
+    };
+
+    using render = std::vector<std::vector<float>>;
+
+    /// \brief Renders a scenario in host blocks, apply takes the events of a block and process renders it
+    template <typename Apply, typename Process>
+    render renderBlocks(const scenario& s, int numOutputChannels, int blockSize, Apply apply, Process process){
+        const int length = (int) s.input[0].size();
+        render output(numOutputChannels, std::vector<float>(length));
+        size_t nextEvent = 0;
+
+        for (int blockStart = 0; blockStart < length; blockStart += blockSize){
+            const int numSamples = std::min(blockSize, length - blockStart);
+            while (nextEvent < s.events.size() && s.events[nextEvent].position < blockStart + numSamples) apply(s.events[nextEvent++]);
+
+            std::vector<const float*> inputs;
+            for (auto& channel : s.input) inputs.push_back(channel.data() + blockStart);
+            std::vector<float*> outputs;
+            for (auto& channel : output) outputs.push_back(channel.data() + blockStart);
+            process(inputs, outputs, numSamples);
+        }
+        return output;
+    }
+
+    /// \brief Renders a scenario through the reference_model
+    render renderReference(const scenario& s, int numOutputChannels, int blockSize){
+        reference_model model(numOutputChannels, s.detailCombs, s.detailAllpasses);
+        return renderBlocks(s, numOutputChannels, blockSize, [&](const event& e){ model.apply(e); },
+                            [&](const std::vector<const float*>& inputs, const std::vector<float*>& outputs, int numSamples){
+                                model.process(inputs, outputs, numSamples);
+                                model.updateRoom();
+                            });
+    }
+
+    /// \brief Renders a scenario through the diffuse_model of the plugin with the calls of AudioPluginAudioProcessor::processBlock
+    /// \param staged processes with diffuse_model::processstages, the stage by stage processing used with the performance counters
+    render renderModel(const scenario& s, int numOutputChannels, int blockSize, const diffuse_kernels::kernel_table& kernels, bool staged = false){
+        diffuse_model model;
+        model.prepare(numInputs, numOutputChannels, sampleRate, blockSize);
+        model.setkernels(kernels);
+        // prepareToPlay applies the detail profile and clears the filters
+        model.applyqualitytier(0, s.detailCombs, s.detailAllpasses);
+        model.reset();
+        auto apply = [&](const event& e){
+            if (e.type == event::room) model.requestroomsize(e.value);
+            else if (e.type == event::damp) model.setdamp(e.value);
+            else if (e.type == event::freeze) model.setfreezemode(e.value > 0.5f);
+            // the processor changes the tier at the start of a block, once the previous change has faded
+            else if (model.canapplyqualitytier()) model.applyqualitytier((int) e.value, s.detailCombs, s.detailAllpasses);
+        };
+        return renderBlocks(s, numOutputChannels, blockSize, apply,
+                            [&](const std::vector<const float*>& inputs, const std::vector<float*>& outputs, int numSamples){
+                                // the part of processBlock that runs on the audio thread must not allocate, lock or block
+                                realtime_check::ScopedRealtimeSection realtime;
+                                model.downmix(inputs.data(), numSamples);
+                                if (staged) model.processstages(outputs.data(), numSamples, nullptr);
+                                else model.process(outputs.data(), numSamples);
+                                model.finishblock();
+                            });
+    }
+
+    //==============================================================================
+    void fft(std::vector<std::complex<double>>& data){
+        const size_t n = data.size();
+        for (size_t i = 1, j = 0; i < n; i++){
+            size_t bit = n >> 1;
+            for (; j & bit; bit >>= 1) j ^= bit;
+            j ^= bit;
+            if (i < j) std::swap(data[i], data[j]);
+        }
+        for (size_t length = 2; length <= n; length <<= 1){
+            const std::complex<double> step = std::polar(1.0, -2.0 * M_PI / length);
+            for (size_t i = 0; i < n; i += length){
+                std::complex<double> w = 1.0;
+                for (size_t k = 0; k < length / 2; k++){
+                    const std::complex<double> a = data[i + k], b = data[i + k + length / 2] * w;
+                    data[i + k] = a + b;
+                    data[i + k + length / 2] = a - b;
+                    w *= step;
+                }
+            }
+        }
+    }
+
+    struct difference{
+        /// largest sample difference relative to the reference peak in dB
+        double maxErrorDb;
+        /// mean and largest log spectral distance over the frames in dB
+        double meanSpectralDb;
+        double maxSpectralDb;
+    };
+
+    /// \brief Log spectral distance of 2048 sample Hann windowed frames, bins more than floorDb below the reference peak are ignored
+    difference compare(const std::vector<float>& reference, const std::vector<float>& signal, double floorDb){
+        double peak = 0.0, maxError = 0.0;
+        for (size_t i = 0; i < reference.size(); i++){
+            peak = std::max(peak, (double) std::fabs(reference[i]));
+            maxError = std::max(maxError, (double) std::fabs(signal[i] - reference[i]));
+        }
+        if (peak == 0.0) peak = 1.0;
+
+        const size_t frameSize = 2048, hop = 1024;
+        std::vector<double> window(frameSize);
+        for (size_t i = 0; i < frameSize; i++) window[i] = 0.5 - 0.5 * std::cos(2.0 * M_PI * i / frameSize);
+
+        const double floorPower = std::pow(peak * frameSize * std::pow(10.0, floorDb / 20.0), 2.0);
+        double sum = 0.0, worst = 0.0;
+        int frames = 0;
+        for (size_t start = 0; start + frameSize <= reference.size(); start += hop){
+            std::vector<std::complex<double>> a(frameSize), b(frameSize);
+            for (size_t i = 0; i < frameSize; i++){
+                a[i] = reference[start + i] * window[i];
+                b[i] = signal[start + i] * window[i];
+            }
+            fft(a);
+            fft(b);
+            double distance = 0.0;
+            int bins = 0;
+            for (size_t k = 0; k <= frameSize / 2; k++){
+                const double pa = std::norm(a[k]), pb = std::norm(b[k]);
+                if (pa < floorPower) continue;
+                const double d = 10.0 * std::log10((pb + 1e-30) / (pa + 1e-30));
+                distance += d * d;
+                bins++;
+            }
+            if (bins == 0) continue;
+            distance = std::sqrt(distance / bins);
+            sum += distance;
+            worst = std::max(worst, distance);
+            frames++;
+        }
+
+        return {20.0 * std::log10(maxError / peak + 1e-30), frames > 0 ? sum / frames : 0.0, worst};
+    }
+
+    struct tolerance{
+        double maxErrorDb;
+        double meanSpectralDb;
+        double maxSpectralDb;
+        /// level below the reference peak under which the spectra are not compared
+        double spectralFloorDb;
+    };
+
+    /// \brief Float delay lines have to match exactly, the compact formats are allowed their noise floor
+    tolerance toleranceFor(){
+        if (std::is_same<delay_storage, float_storage>::value) return {-300.0, 0.0, 0.0, -100.0};
+        if (std::is_same<delay_storage, half_storage>::value) return {-45.0, 0.5, 3.0, -100.0};
+        // the dither of int16_storage is a constant noise floor that covers the end of the tail
+        return {-25.0, 1.5, 10.0, -60.0};
+    }
+
+    bool check(const std::string& label, const render& reference, const render& signal, const tolerance& tol, bool verbose){
+        bool passed = true;
+        difference worst{-400.0, 0.0, 0.0};
+        for (size_t channel = 0; channel < reference.size(); channel++){
+            const difference d = compare(reference[channel], signal[channel], tol.spectralFloorDb);
+            const bool ok = d.maxErrorDb <= tol.maxErrorDb && d.meanSpectralDb <= tol.meanSpectralDb && d.maxSpectralDb <= tol.maxSpectralDb;
+            if (! ok || verbose)
+                std::printf("  %s channel %zu: max error %.1f dB, spectral distance %.3f dB mean %.3f dB max%s\n",
+                            label.c_str(), channel, d.maxErrorDb, d.meanSpectralDb, d.maxSpectralDb, ok ? "" : "  FAILED");
+            passed = passed && ok;
+            worst = {std::max(worst.maxErrorDb, d.maxErrorDb), std::max(worst.meanSpectralDb, d.meanSpectralDb), std::max(worst.maxSpectralDb, d.maxSpectralDb)};
+        }
+        std::printf("%-48s %s  max error %7.1f dB, spectral distance %.3f / %.3f dB\n", label.c_str(), passed ? "ok    " : "FAILED",
+                    worst.maxErrorDb, worst.meanSpectralDb, worst.maxSpectralDb);
+        return passed;
+    }
+
+    /// largest level difference around a quality tier change, the combs that run again start empty and the level dips by up to 3 dB at order 7 until they are filled
+    const double maxTierLevelErrorDb = 3.5;
+
+    /// \brief Compares the level of a render with quality tier changes to the render of the full tier, in 10 ms windows of all channels from 50 ms before to 200 ms after every change
+    bool checkTierLevel(const std::string& label, const scenario& s, const render& tiered, const render& full, bool verbose){
+        const int window = (int) (0.01 * sampleRate);
+        double worst = 0.0;
+        for (const event& e : s.events){
+            if (e.type != event::tier) continue;
+            for (int start = std::max(0, e.position - 5 * window); start < e.position + 20 * window && start + window <= (int) full[0].size(); start += window){
+                double tieredEnergy = 0.0, fullEnergy = 0.0;
+                for (size_t channel = 0; channel < full.size(); channel++){
+                    for (int i = start; i < start + window; i++){
+                        tieredEnergy += (double) tiered[channel][i] * tiered[channel][i];
+                        fullEnergy += (double) full[channel][i] * full[channel][i];
+                    }
+                }
+                const double errorDb = 10.0 * std::log10((tieredEnergy + 1e-30) / (fullEnergy + 1e-30));
+                if (verbose) std::printf("  %s %.2f s: %.2f dB\n", label.c_str(), start / sampleRate, errorDb);
+                worst = std::max(worst, std::fabs(errorDb));
+            }
+        }
+        const bool passed = worst <= maxTierLevelErrorDb;
+        std::printf("%-48s %s  level error %5.2f dB\n", label.c_str(), passed ? "ok    " : "FAILED", worst);
+        return passed;
+    }
+
+    //==============================================================================
+    const char recordingMagic[4] = {'R', 'V', 'B', 'G'};
+    /// version 2 added the step
+    const uint32_t recordingVersion = 2;
+
+    /// \brief Keeps every step-th sample of a render
+    render decimate(const render& r, int step){
+        render decimated;
+        for (auto& channel : r){
+            decimated.emplace_back();
+            for (size_t i = 0; i < channel.size(); i += (size_t) step) decimated.back().push_back(channel[i]);
+        }
+        return decimated;
+    }
+
+    /// \brief Writes every step-th sample of a render
+    bool writeRecording(const std::string& path, const render& r, int step = 1){
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr) return false;
+        const render samples = decimate(r, step);
+        const uint32_t header[5] = {recordingVersion, (uint32_t) samples.size(), (uint32_t) samples[0].size(), (uint32_t) sampleRate, (uint32_t) step};
+        std::fwrite(recordingMagic, 1, sizeof(recordingMagic), file);
+        std::fwrite(header, sizeof(uint32_t), 5, file);
+        for (auto& channel : samples) std::fwrite(channel.data(), sizeof(float), channel.size(), file);
+        return std::fclose(file) == 0;
+    }
+
+    /// \brief Reads a recording written with the given step
+    bool readRecording(const std::string& path, render& r, int step = 1){
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr) return false;
+        char magic[4];
+        uint32_t header[5];
+        bool ok = std::fread(magic, 1, 4, file) == 4 && std::memcmp(magic, recordingMagic, 4) == 0
+               && std::fread(header, sizeof(uint32_t), 5, file) == 5 && header[0] == recordingVersion
+               && header[3] == (uint32_t) sampleRate && header[4] == (uint32_t) step;
+        if (ok){
+            r.assign(header[1], std::vector<float>(header[2]));
+            for (auto& channel : r) ok = ok && std::fread(channel.data(), sizeof(float), channel.size(), file) == channel.size();
+        }
+        std::fclose(file);
+        return ok;
+    }
+
+    /// \brief Compares a decimated render with a fixture by the largest sample difference of every channel relative to the peak of the fixture
+    bool checkFixture(const std::string& label, const render& fixture, const render& samples, double maxErrorDb, bool verbose){
+        if (fixture.size() != samples.size() || fixture[0].size() != samples[0].size()){
+            std::printf("%-48s FAILED  the fixture has another length or channel count\n", label.c_str());
+            return false;
+        }
+        bool passed = true;
+        double worst = -400.0;
+        for (size_t channel = 0; channel < fixture.size(); channel++){
+            double peak = 0.0, maxError = 0.0;
+            for (size_t i = 0; i < fixture[channel].size(); i++){
+                peak = std::max(peak, (double) std::fabs(fixture[channel][i]));
+                maxError = std::max(maxError, (double) std::fabs(samples[channel][i] - fixture[channel][i]));
+            }
+            const double errorDb = 20.0 * std::log10(maxError / (peak > 0.0 ? peak : 1.0) + 1e-30);
+            const bool ok = errorDb <= maxErrorDb;
+            if (! ok || verbose) std::printf("  %s channel %zu: max error %.1f dB%s\n", label.c_str(), channel, errorDb, ok ? "" : "  FAILED");
+            passed = passed && ok;
+            worst = std::max(worst, errorDb);
+        }
+        std::printf("%-48s %s  max error %7.1f dB\n", label.c_str(), passed ? "ok    " : "FAILED", worst);
+        return passed;
+    }
+
+    /// \brief The fixtures may have been rendered by another compiler and C library, float delay lines get a margin far below any change of the filters
+    double fixtureToleranceDb(){
+        return std::is_same<delay_storage, float_storage>::value ? -120.0 : toleranceFor().maxErrorDb;
+    }
+
+    struct options{
+        int order = 3;
+        std::string record;
+        std::string compare;
+#ifdef REVERB_GOLDEN_FIXTURES
+        std::string fixtures = REVERB_GOLDEN_FIXTURES;
+#else
+        std::string fixtures = "bench/golden";
+#endif
+        std::string writeFixtures;
+        bool verbose = false;
+    };
+
+    options parseOptions(int argc, char* argv[]){
+        options opts;
+        for (int i = 1; i < argc; i++){
+            const std::string arg = argv[i];
+            if (arg == "--order" && i + 1 < argc) opts.order = std::clamp(std::atoi(argv[++i]), 0, 7);
+            else if (arg == "--record" && i + 1 < argc) opts.record = argv[++i];
+            else if (arg == "--compare" && i + 1 < argc) opts.compare = argv[++i];
+            else if (arg == "--fixtures" && i + 1 < argc) opts.fixtures = argv[++i];
+            else if (arg == "--write-fixtures" && i + 1 < argc) opts.writeFixtures = argv[++i];
+            else if (arg == "--verbose") opts.verbose = true;
+            else{
+                std::fprintf(stderr, "usage: %s [--order n] [--record dir] [--compare dir] [--fixtures dir] [--write-fixtures dir] [--verbose]\n", argv[0]);
+                std::exit(arg == "--help" ? 0 : 2);
+            }
+        }
+        return opts;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const options opts = parseOptions(argc, argv);
+    const int numOutputChannels = (opts.order + 1) * (opts.order + 1);
+    const tolerance tol = toleranceFor();
+    const std::vector<int> blockSizes = {32, 256, 500, 2048};
+
+    std::vector<diffuse_kernels::instruction_set> sets;
+    for (auto set : {diffuse_kernels::instruction_set::generic, diffuse_kernels::instruction_set::sse2,
+                     diffuse_kernels::instruction_set::avx2, diffuse_kernels::instruction_set::avx512}){
+        if (diffuse_kernels::is_supported(set)) sets.push_back(set);
+    }
+    const diffuse_kernels::kernel_table& detected = diffuse_kernels::get_kernels(diffuse_kernels::detect_instruction_set());
+
+    std::printf("order %d (%d channels), %s delay lines, real-time checks %s\n", opts.order, numOutputChannels,
+                std::is_same<delay_storage, float_storage>::value ? "float" : std::is_same<delay_storage, half_storage>::value ? "half" : "int16",
+                realtime_check::is_available() ? "on" : "not available");
+
+    bool passed = true;
+    for (const scenario& s : makeScenarios()){
+        const int order = s.order < 0 ? opts.order : s.order;
+        const int channels = (order + 1) * (order + 1);
+        for (int blockSize : blockSizes){
+            const render reference = renderReference(s, channels, blockSize);
+            for (auto set : sets){
+                const diffuse_kernels::kernel_table& kernels = diffuse_kernels::get_kernels(set);
+                const render optimized = renderModel(s, channels, blockSize, kernels);
+                const std::string label = s.name + " block " + std::to_string(blockSize) + " " + kernels.name;
+                passed = check(label, reference, optimized, tol, opts.verbose) && passed;
+            }
+            const render staged = renderModel(s, channels, blockSize, detected, true);
+            passed = check(s.name + " block " + std::to_string(blockSize) + " " + detected.name + " staged", reference, staged, tol, opts.verbose) && passed;
+        }
+
+        // the combs a tier drops are made up for by the gain of the others
+        scenario fullTier = s;
+        fullTier.events.erase(std::remove_if(fullTier.events.begin(), fullTier.events.end(), [](const event& e){ return e.type == event::tier; }), fullTier.events.end());
+        if (fullTier.events.size() != s.events.size())
+            passed = checkTierLevel(s.name + " level at the tier changes", s, renderModel(s, channels, recordingBlockSize, detected),
+                                    renderModel(fullTier, channels, recordingBlockSize, detected), opts.verbose) && passed;
+
+        if (! opts.record.empty() || ! opts.compare.empty()){
+            const render current = renderModel(s, channels, recordingBlockSize, detected);
+            if (! opts.record.empty()){
+                const std::string path = opts.record + "/" + s.name + "_order" + std::to_string(order) + ".rvbg";
+                if (! writeRecording(path, current)){
+                    std::fprintf(stderr, "could not write %s\n", path.c_str());
+                    return 2;
+                }
+            }
+            if (! opts.compare.empty()){
+                const std::string path = opts.compare + "/" + s.name + "_order" + std::to_string(order) + ".rvbg";
+                render recorded;
+                if (! readRecording(path, recorded) || recorded.size() != current.size() || recorded[0].size() != current[0].size()){
+                    std::fprintf(stderr, "could not read a matching recording from %s\n", path.c_str());
+                    return 2;
+                }
+                passed = check(s.name + " against " + path, recorded, current, tol, opts.verbose) && passed;
+            }
+        }
+    }
+
+    // the fixtures catch changes of the filters, which the reference path shares with the optimized one
+    const bool fixturesApply = std::is_same<delay_interpolation, linear_interpolation>::value;
+    if (! fixturesApply && opts.writeFixtures.empty())
+        std::printf("fixtures skipped, they were rendered with linear interpolation\n");
+    for (const scenario& s : makeScenarios()){
+        if (! fixturesApply && opts.writeFixtures.empty()) break;
+        const int order = s.order < 0 ? fixtureOrder : s.order;
+        const render current = renderModel(s, (order + 1) * (order + 1), recordingBlockSize, detected);
+        const std::string name = s.name + "_order" + std::to_string(order) + ".rvbg";
+        if (! opts.writeFixtures.empty()){
+            if (! std::is_same<delay_storage, float_storage>::value || ! fixturesApply){
+                std::fprintf(stderr, "fixtures are written by builds with float delay lines and linear interpolation only\n");
+                return 2;
+            }
+            if (! writeRecording(opts.writeFixtures + "/" + name, current, fixtureStep)){
+                std::fprintf(stderr, "could not write %s/%s\n", opts.writeFixtures.c_str(), name.c_str());
+                return 2;
+            }
+            continue;
+        }
+        render fixture;
+        if (! readRecording(opts.fixtures + "/" + name, fixture, fixtureStep)){
+            std::fprintf(stderr, "could not read the fixture %s/%s\n", opts.fixtures.c_str(), name.c_str());
+            return 2;
+        }
+        passed = checkFixture(s.name + " against the fixture", fixture, decimate(current, fixtureStep), fixtureToleranceDb(), opts.verbose) && passed;
+    }
+
+    std::printf(passed ? "all renders within tolerance\n" : "some renders differ from the reference\n");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+/**
+ * \file processor_bench.cpp
+ *
+ * \brief Throughput and scaling benchmark of the whole AudioPluginAudioProcessor.
+ *
+ * \details The processor is instantiated without a host, an audio device or an editor and driven through prepareToPlay and processBlock like a host would do. Every combination of ambisonic order (0 to 7, 1 to 64 output channels), sample rate and buffer size is run with a fresh processor on a stereo noise input, every block is timed on its own. The reported numbers are
+ *  - the realtime factor, the duration of the processed audio divided by the processing time,
+ *  - the worst-case block time, also as a fraction of the block period (the deadline of the audio callback),
+ *  - the 99th and 99.9th percentile of the load and the deadline misses counted by the block_load_monitor of the processor,
+ *  - the number of output channels one core sustains at 64 samples per block, extrapolated from the highest order with the mean block time.
+ *
+ * The results are written as JSON, a table goes to stdout.
+ *
+ * With --rt-check every processBlock call runs in a realtime_check::ScopedRealtimeSection while all parameters are automated between the blocks, the program aborts with a stack trace if processBlock allocates, locks or blocks.
+ *
+ * With --trace the spans of the last blocks are written as Chrome trace event JSON, in builds with REVERB_TRACE (see source/trace.h).
+ *
+ * Usage: reverb_processor_bench [--output file.json] [--seconds s] [--quick] [--rt-check] [--trace file.json]
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "PluginProcessor.h"
+#include "realtime_check.h"
+
+namespace
+{
+    struct options{
+        std::string output = "reverb_processor_bench.json";
+        double seconds = 2.0;
+        bool quick = false;
+        bool rtCheck = false;
+        /// Chrome trace event file of the last blocks, needs a build with REVERB_TRACE
+        std::string trace;
+    };
+
+    struct measurement{
+        int order;
+        int numChannels;
+        double sampleRate;
+        int blockSize;
+        double realtimeFactor;
+        double meanBlockUs;
+        double worstBlockUs;
+        double worstBlockLoad;
+        /// as seen by the block_load_monitor of the processor
+        double p99Load;
+        double p999Load;
+        uint64_t deadlineMisses;
+    };
+
+    /// \brief Changes all parameters like a host automating them from the message thread
+    void automate(AudioPluginAudioProcessor& processor, int step){
+        const float values[] = {0.9f, 0.2f, 0.75f, 0.4f};
+        const float value = values[step % 4];
+        processor.parameterChanged(PARAM_ROOM_SIZE_ID, value);
+        processor.parameterChanged(PARAM_DAMP_ID, 1.f - value);
+        processor.parameterChanged(PARAM_WET_ID, value);
+        processor.parameterChanged(PARAM_DRY_ID, 1.f - value);
+        processor.parameterChanged(PARAM_FREEZE_ID, step % 8 == 5 ? 1.f : 0.f);
+        // without thresholds the governor steps down to the lowest tier, disabled it returns to tier 0
+        quality_governor::settings governor = quality_governor::default_settings();
+        governor.enabled = step % 8 < 4;
+        governor.upper_load = 0.f;
+        governor.lower_load = 0.f;
+        processor.setqualitygovernor(governor);
+    }
+
+    measurement run(int order, double sampleRate, int blockSize, const options& opts){
+        const int numInputs = AudioPluginAudioProcessor::numberOfInputChannels;
+        const int numChannels = (order + 1) * (order + 1);
+
+        AudioPluginAudioProcessor processor;
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(juce::AudioChannelSet::stereo());
+        layout.outputBuses.add(juce::AudioChannelSet::discreteChannels(numChannels));
+        if (! processor.setBusesLayout(layout)){
+            std::fprintf(stderr, "the processor does not accept %d output channels\n", numChannels);
+            std::exit(1);
+        }
+        processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+        // what the parameter listener does when the host restores the room size
+        processor.parameterChanged(PARAM_ROOM_SIZE_ID, initialroom);
+        // the numbers are the ones of the full diffuse model
+        quality_governor::settings governor = processor.getqualitygovernor();
+        governor.enabled = false;
+        processor.setqualitygovernor(governor);
+
+        juce::AudioBuffer<float> buffer(std::max(numInputs, numChannels), blockSize);
+        juce::MidiBuffer midi;
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+        std::vector<float> input((size_t) blockSize * numInputs);
+        for (float& sample : input) sample = noise(rng);
+
+        auto processOneBlock = [&](){
+            for (int channel = 0; channel < numInputs; channel++) buffer.copyFrom(channel, 0, input.data() + channel * blockSize, blockSize);
+            const auto start = std::chrono::steady_clock::now();
+            if (opts.rtCheck){
+                realtime_check::ScopedRealtimeSection realtime;
+                processor.processBlock(buffer, midi);
+            }
+            else processor.processBlock(buffer, midi);
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        // one second of warm-up, so that the reverb tail is dense and the caches are warm
+        const int warmupBlocks = (int) (sampleRate / blockSize) + 1;
+        for (int block = 0; block < warmupBlocks; block++) processOneBlock();
+        processor.getloadmonitor().request_reset();
+
+        const int numBlocks = std::max(1, (int) (opts.seconds * sampleRate / blockSize));
+        // a parameter change about every 50 ms
+        const int automationInterval = std::max(1, (int) (0.05 * sampleRate / blockSize));
+        double total = 0.0, worst = 0.0;
+        for (int block = 0; block < numBlocks; block++){
+            if (opts.rtCheck && block % automationInterval == 0) automate(processor, block / automationInterval);
+            const double blockTime = processOneBlock();
+            total += blockTime;
+            worst = std::max(worst, blockTime);
+        }
+        const block_load_monitor::statistics load = processor.getloadmonitor().get_statistics();
+        processor.releaseResources();
+
+        const double blockPeriodUs = 1.0e6 * blockSize / sampleRate;
+        const double meanBlockUs = total / numBlocks;
+        return {order, numChannels, sampleRate, blockSize, blockPeriodUs / meanBlockUs, meanBlockUs, worst, worst / blockPeriodUs,
+                load.p99, load.p999, load.deadline_misses};
+    }
+
+    void writeJson(const options& opts, const std::vector<measurement>& results, const std::vector<std::pair<double, double>>& sustained){
+        FILE* file = std::fopen(opts.output.c_str(), "w");
+        if (file == nullptr){
+            std::fprintf(stderr, "could not write %s\n", opts.output.c_str());
+            std::exit(1);
+        }
+
+        std::fprintf(file, "{\n  \"benchmark\": \"reverb_processor_bench\",\n  \"seconds_per_run\": %g,\n", opts.seconds);
+        std::fprintf(file, "  \"channels_sustained_at_64_samples\": [");
+        for (size_t i = 0; i < sustained.size(); i++)
+            std::fprintf(file, "%s{\"sample_rate\": %g, \"channels\": %.1f}", i > 0 ? ", " : "", sustained[i].first, sustained[i].second);
+        std::fprintf(file, "],\n  \"results\": [\n");
+        for (size_t i = 0; i < results.size(); i++){
+            const measurement& m = results[i];
+            std::fprintf(file, "    {\"order\": %d, \"channels\": %d, \"sample_rate\": %g, \"block_size\": %d, \"realtime_factor\": %.3f, "
+                               "\"mean_block_us\": %.3f, \"worst_block_us\": %.3f, \"worst_block_load\": %.4f, "
+                               "\"p99_load\": %.4f, \"p999_load\": %.4f, \"deadline_misses\": %llu}%s\n",
+                         m.order, m.numChannels, m.sampleRate, m.blockSize, m.realtimeFactor, m.meanBlockUs, m.worstBlockUs, m.worstBlockLoad,
+                         m.p99Load, m.p999Load, (unsigned long long) m.deadlineMisses, i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(file, "  ]\n}\n");
+        std::fclose(file);
+    }
+
+    options parseOptions(int argc, char* argv[]){
+        options opts;
+        for (int i = 1; i < argc; i++){
+            const std::string arg = argv[i];
+            if (arg == "--output" && i + 1 < argc) opts.output = argv[++i];
+            else if (arg == "--seconds" && i + 1 < argc) opts.seconds = std::max(0.01, std::atof(argv[++i]));
+            else if (arg == "--quick") opts.quick = true;
+            else if (arg == "--rt-check") opts.rtCheck = true;
+            else if (arg == "--trace" && i + 1 < argc) opts.trace = argv[++i];
+            else{
+                std::fprintf(stderr, "usage: %s [--output file.json] [--seconds s] [--quick] [--rt-check] [--trace file.json]\n", argv[0]);
+                std::exit(arg == "--help" ? 0 : 1);
+            }
+        }
+        return opts;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    options opts = parseOptions(argc, argv);
+    if (opts.quick) opts.seconds = std::min(opts.seconds, 0.25);
+
+    // the parameter tree of the processor needs the message manager
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    if (opts.rtCheck){
+        if (! realtime_check::is_available()){
+            std::fprintf(stderr, "the real-time checks are not available on this system\n");
+            return 1;
+        }
+        if (perf_counters::is_compiled_in()){
+            std::fprintf(stderr, "the performance counters read their values with a system call, build without REVERB_PERF_COUNTERS for the real-time checks\n");
+            return 1;
+        }
+        std::printf("real-time checks on, the timings are taken under parameter automation\n");
+    }
+
+    const std::vector<int> orders = opts.quick ? std::vector<int>{0, 1, 3, 7} : std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7};
+    const std::vector<double> sampleRates = opts.quick ? std::vector<double>{48000.0} : std::vector<double>{44100.0, 48000.0, 96000.0, 192000.0};
+    const std::vector<int> blockSizes = opts.quick ? std::vector<int>{64, 512} : std::vector<int>{32, 64, 128, 256, 512, 1024, 2048};
+
+    if (! opts.trace.empty() && ! trace::is_compiled_in()){
+        std::fprintf(stderr, "tracing is not built in, configure with -DREVERB_TRACE=ON\n");
+        return 1;
+    }
+    REVERB_TRACE_THREAD_NAME("processor_bench");
+
+    std::printf("%5s %8s %8s %6s %12s %14s %14s %10s %9s %9s\n", "order", "channels", "rate", "block", "realtime", "mean block us", "worst block us", "worst load", "p99 load", "p99.9");
+
+    std::vector<measurement> results;
+    for (double sampleRate : sampleRates){
+        for (int order : orders){
+            for (int blockSize : blockSizes){
+                const measurement m = run(order, sampleRate, blockSize, opts);
+                std::printf("%5d %8d %8.0f %6d %11.1fx %14.2f %14.2f %9.1f%% %8.1f%% %8.1f%%\n", m.order, m.numChannels, m.sampleRate, m.blockSize,
+                            m.realtimeFactor, m.meanBlockUs, m.worstBlockUs, 100.0 * m.worstBlockLoad, 100.0 * m.p99Load, 100.0 * m.p999Load);
+                results.push_back(m);
+            }
+        }
+    }
+
+    // The cost grows linearly with the number of channels, so the highest order gives the best estimate.
+    std::vector<std::pair<double, double>> sustained;
+    for (double sampleRate : sampleRates){
+        const measurement* best = nullptr;
+        for (const measurement& m : results){
+            if (m.sampleRate == sampleRate && m.blockSize == 64 && (best == nullptr || m.numChannels > best->numChannels)) best = &m;
+        }
+        if (best != nullptr){
+            sustained.emplace_back(sampleRate, best->numChannels * best->realtimeFactor);
+            std::printf("one core sustains about %.0f channels at %.0f Hz and 64 samples per block\n", best->numChannels * best->realtimeFactor, sampleRate);
+        }
+    }
+
+    writeJson(opts, results, sustained);
+    std::printf("results written to %s\n", opts.output.c_str());
+    if (! opts.trace.empty()){
+        if (! trace::dump(opts.trace.c_str())){
+            std::fprintf(stderr, "could not write %s\n", opts.trace.c_str());
+            return 1;
+        }
+        std::printf("trace written to %s\n", opts.trace.c_str());
+    }
+    return 0;
+}
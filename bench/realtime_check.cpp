@@ -0,0 +1,200 @@
+/**
+ * \file realtime_check.cpp
+ *
+ * \brief Source for the real-time safety checks
+ *
+ * \details The allocation functions forward to the __libc_* entry points of glibc, so that they do not depend on dlsym, which allocates itself. All other functions are looked up with dlsym(RTLD_NEXT) before main runs. The report is written with the real write function and backtrace_symbols_fd, which do not allocate, backtrace is called once at startup because it loads libgcc on its first use.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+
+#include "realtime_check.h"
+
+// defines __GLIBC__
+#include <cstdlib>
+
+#if defined(__linux__) && defined(__GLIBC__)
+
+#include <cstdarg>
+#include <cstring>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* pointer, size_t size);
+    void  __libc_free(void* pointer);
+}
+
+namespace realtime_check
+{
+    namespace
+    {
+        /// depth of nested ScopedRealtimeSection instances on this thread
+        thread_local int realtimeDepth = 0;
+
+        using read_function = ssize_t (*)(int, void*, size_t);
+        using write_function = ssize_t (*)(int, const void*, size_t);
+        using open_function = int (*)(const char*, int, ...);
+        using poll_function = int (*)(struct pollfd*, nfds_t, int);
+        using nanosleep_function = int (*)(const struct timespec*, struct timespec*);
+        using usleep_function = int (*)(useconds_t);
+        using mutex_lock_function = int (*)(pthread_mutex_t*);
+        using cond_wait_function = int (*)(pthread_cond_t*, pthread_mutex_t*);
+        using sem_wait_function = int (*)(sem_t*);
+
+        read_function real_read = nullptr;
+        write_function real_write = nullptr;
+        open_function real_open = nullptr;
+        poll_function real_poll = nullptr;
+        nanosleep_function real_nanosleep = nullptr;
+        usleep_function real_usleep = nullptr;
+        mutex_lock_function real_pthread_mutex_lock = nullptr;
+        cond_wait_function real_pthread_cond_wait = nullptr;
+        sem_wait_function real_sem_wait = nullptr;
+
+        /// \brief Gets the C library function, calls from constructors that run before initialise look it up on their own
+        template <typename Function>
+        Function lookup(Function& function, const char* name){
+            if (function == nullptr) function = reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+            return function;
+        }
+
+        __attribute__((constructor)) void initialise(){
+            lookup(real_read, "read");
+            lookup(real_write, "write");
+            lookup(real_open, "open");
+            lookup(real_poll, "poll");
+            lookup(real_nanosleep, "nanosleep");
+            lookup(real_usleep, "usleep");
+            lookup(real_pthread_cond_wait, "pthread_cond_wait");
+            lookup(real_sem_wait, "sem_wait");
+            lookup(real_pthread_mutex_lock, "pthread_mutex_lock");
+
+            void* frames[1];
+            backtrace(frames, 1);
+        }
+
+        void print(const char* text){
+            lookup(real_write, "write")(STDERR_FILENO, text, std::strlen(text));
+        }
+
+        /// \brief Reports a call inside a real-time section and aborts
+        void check(const char* function){
+            if (realtimeDepth == 0) return;
+            // no further checks while reporting
+            realtimeDepth = 0;
+
+            print("realtime_check: ");
+            print(function);
+            print(" called in a real-time section\n");
+            void* frames[64];
+            const int numFrames = backtrace(frames, 64);
+            backtrace_symbols_fd(frames, numFrames, STDERR_FILENO);
+            std::abort();
+        }
+    }
+
+    ScopedRealtimeSection::ScopedRealtimeSection() { realtimeDepth++; }
+    ScopedRealtimeSection::~ScopedRealtimeSection() { realtimeDepth--; }
+
+    bool is_available() { return true; }
+}
+
+using realtime_check::check;
+
+extern "C" {
+    void* malloc(size_t size){
+        check("malloc");
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size){
+        check("calloc");
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* pointer, size_t size){
+        check("realloc");
+        return __libc_realloc(pointer, size);
+    }
+
+    void free(void* pointer){
+        if (pointer != nullptr) check("free");
+        __libc_free(pointer);
+    }
+
+    ssize_t read(int fd, void* buffer, size_t count){
+        check("read");
+        return realtime_check::lookup(realtime_check::real_read, "read")(fd, buffer, count);
+    }
+
+    ssize_t write(int fd, const void* buffer, size_t count){
+        check("write");
+        return realtime_check::lookup(realtime_check::real_write, "write")(fd, buffer, count);
+    }
+
+    int open(const char* path, int flags, ...){
+        check("open");
+        mode_t mode = 0;
+        if (flags & (O_CREAT | O_TMPFILE)){
+            va_list arguments;
+            va_start(arguments, flags);
+            mode = va_arg(arguments, mode_t);
+            va_end(arguments);
+        }
+        return realtime_check::lookup(realtime_check::real_open, "open")(path, flags, mode);
+    }
+
+    int poll(struct pollfd* fds, nfds_t numFds, int timeout){
+        check("poll");
+        return realtime_check::lookup(realtime_check::real_poll, "poll")(fds, numFds, timeout);
+    }
+
+    int nanosleep(const struct timespec* duration, struct timespec* remaining){
+        check("nanosleep");
+        return realtime_check::lookup(realtime_check::real_nanosleep, "nanosleep")(duration, remaining);
+    }
+
+    int usleep(useconds_t duration){
+        check("usleep");
+        return realtime_check::lookup(realtime_check::real_usleep, "usleep")(duration);
+    }
+
+    int pthread_mutex_lock(pthread_mutex_t* mutex){
+        check("pthread_mutex_lock");
+        return realtime_check::lookup(realtime_check::real_pthread_mutex_lock, "pthread_mutex_lock")(mutex);
+    }
+
+    int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex){
+        check("pthread_cond_wait");
+        return realtime_check::lookup(realtime_check::real_pthread_cond_wait, "pthread_cond_wait")(condition, mutex);
+    }
+
+    int sem_wait(sem_t* semaphore){
+        check("sem_wait");
+        return realtime_check::lookup(realtime_check::real_sem_wait, "sem_wait")(semaphore);
+    }
+}
+
+#else
+
+namespace realtime_check
+{
+    ScopedRealtimeSection::ScopedRealtimeSection() {}
+    ScopedRealtimeSection::~ScopedRealtimeSection() {}
+
+    bool is_available() { return false; }
+}
+
+#endif
@@ -0,0 +1,34 @@
+/**
+ * \file realtime_check.h
+ *
+ * \brief Detects calls that are not real-time safe on the audio thread.
+ *
+ * \details Linking realtime_check.cpp into a program replaces malloc, calloc, realloc, free, pthread_mutex_lock, pthread_cond_wait, sem_wait and the blocking system calls read, write, open, poll, nanosleep and usleep with versions that check whether the calling thread is inside a realtime_check::ScopedRealtimeSection. Outside of such a section they forward to the C library. Inside they print the name of the call and a stack trace to stderr and abort the program, so every code path that allocates, locks or blocks in processBlock is found by running it once.
+ *
+ * The checks need glibc on Linux. On other systems the sections do nothing and realtime_check::is_available returns false.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#ifndef realtime_check_h
+#define realtime_check_h
+
+namespace realtime_check
+{
+    /// \brief Marks the current thread as running real-time code while it exists, sections may be nested
+    class ScopedRealtimeSection{
+    public:
+        ScopedRealtimeSection();
+        ~ScopedRealtimeSection();
+
+        ScopedRealtimeSection(const ScopedRealtimeSection&) = delete;
+        ScopedRealtimeSection& operator=(const ScopedRealtimeSection&) = delete;
+    };
+
+    /// \brief Checks whether the calls are intercepted on this system
+    bool is_available();
+}
+
+#endif /* realtime_check_h */
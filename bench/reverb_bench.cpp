@@ -0,0 +1,388 @@
+/**
+ * \file reverb_bench.cpp
+ *
+ * \brief Microbenchmarks for the DSP kernels of the diffuse model.
+ *
+ * \details Measures the time per sample of
+ *  - comb_filter::process and allpass_filter::process for all delay line storage formats, sweeping the delay length and the number of channels,
+ *  - the fractional delay interpolation policies used by read_buffer while a delay line grows or shrinks,
+ *  - the input mixing kernel and the fused channel kernel (comb bank, allpass chain, SN3D scaling and ACN0 accumulation) for every instruction set the CPU supports, sweeping the block size and the number of channels.
+ *
+ * Every case is run once for warm-up and then repeated, the median and the minimum of the repetitions are reported in ns per sample and, on x86, in TSC cycles per sample (the TSC runs at the nominal clock, not the boost clock). One sample means one sample of one filter, interpolated read or channel. The results are written as JSON, a short summary goes to stdout. The benchmark does not need JUCE, an audio device or a display.
+ *
+ * Usage: reverb_bench [--output file.json] [--repetitions n] [--quick] [--suite name]
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define REVERB_BENCH_HAS_TSC 1
+#else
+    #define REVERB_BENCH_HAS_TSC 0
+#endif
+
+#include "comb_filter.h"
+#include "allpass_filter.h"
+#include "diffuse_kernels.h"
+#include "tuning.h"
+
+namespace
+{
+    struct options{
+        std::string output = "reverb_bench.json";
+        int repetitions = 7;
+        bool quick = false;
+        std::string suite;
+    };
+
+    struct parameter{
+        std::string name;
+        std::string value;
+        bool quoted;
+    };
+
+    struct measurement{
+        std::string suite;
+        std::vector<parameter> parameters;
+        double nsPerSample;
+        double nsPerSampleMin;
+        double cyclesPerSample;
+    };
+
+    inline uint64_t readCycles(){
+#if REVERB_BENCH_HAS_TSC
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    /// prevents the compiler from removing results that are not used otherwise
+    volatile float sink;
+
+    /// \brief Runs a case once for warm-up and then repeatedly
+    /// \param run processes one repetition and returns the number of samples it processed
+    measurement measure(const options& opts, const std::string& suite, std::vector<parameter> parameters, const std::function<double()>& run){
+        run();
+
+        std::vector<double> ns, cycles;
+        for (int i = 0; i < opts.repetitions; i++){
+            const uint64_t c0 = readCycles();
+            const auto t0 = std::chrono::steady_clock::now();
+            const double samples = run();
+            const auto t1 = std::chrono::steady_clock::now();
+            const uint64_t c1 = readCycles();
+            ns.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count() / samples);
+            cycles.push_back((double) (c1 - c0) / samples);
+        }
+        std::sort(ns.begin(), ns.end());
+        std::sort(cycles.begin(), cycles.end());
+
+        measurement m{suite, std::move(parameters), ns[ns.size() / 2], ns.front(), cycles[cycles.size() / 2]};
+
+        std::printf("%-16s", suite.c_str());
+        for (auto& p : m.parameters) std::printf(" %s=%s", p.name.c_str(), p.value.c_str());
+        std::printf("  %.3f ns/sample", m.nsPerSample);
+        if (REVERB_BENCH_HAS_TSC) std::printf("  %.2f cycles/sample", m.cyclesPerSample);
+        std::printf("\n");
+        return m;
+    }
+
+    parameter number(const char* name, double value){
+        char text[32];
+        std::snprintf(text, sizeof(text), "%g", value);
+        return {name, text, false};
+    }
+
+    parameter text(const char* name, const std::string& value){
+        return {name, value, true};
+    }
+
+    const char* isaName(diffuse_kernels::instruction_set set){
+        return diffuse_kernels::get_kernels(set).name;
+    }
+
+    //==============================================================================
+    /// \brief numFilters delay lines of one type, initialized like the diffuse model with the given base delay
+    template <typename Filter>
+    struct filter_bank{
+        std::vector<Filter> filters;
+
+        filter_bank(int numFilters, int delay) : filters(numFilters){
+            for (int i = 0; i < numFilters; i++){
+                // spread the delays like the channels of the diffuse model
+                const int size = delay + (i * spreadvalue) % 97;
+                filters[i].initBuffer(size);
+                filters[i].setbuffer(size);
+                filters[i].setfeedback(0.83f);
+            }
+        }
+    };
+
+    template <typename Storage, typename Interpolation>
+    void setupDamping(basic_comb_filter<Storage, Interpolation>& filter){
+        filter.setdamp(initialdamp);
+    }
+
+    template <typename Filter>
+    void setupDamping(Filter&) {}
+
+    template <typename Filter>
+    void benchFilters(const options& opts, std::vector<measurement>& results, const char* suite, const char* storage, int filtersPerChannel){
+        const std::vector<int> delays = opts.quick ? std::vector<int>{557, 2194} : std::vector<int>{64, 557, 2194, 4740};
+        const std::vector<int> channels = opts.quick ? std::vector<int>{1, 63} : std::vector<int>{1, 16, 63};
+        const int blockSize = 256;
+        const int numBlocks = opts.quick ? 32 : 128;
+
+        std::vector<float> input(blockSize);
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+        for (float& sample : input) sample = noise(rng);
+
+        for (int delay : delays){
+            for (int numChannels : channels){
+                filter_bank<Filter> bank(numChannels * filtersPerChannel, delay);
+                for (auto& filter : bank.filters) setupDamping(filter);
+
+                auto run = [&](){
+                    float acc = 0.f;
+                    for (int block = 0; block < numBlocks; block++){
+                        for (auto& filter : bank.filters){
+                            for (int sample = 0; sample < blockSize; sample++) acc += filter.process(input[sample]);
+                        }
+                    }
+                    sink = acc;
+                    return (double) numBlocks * blockSize * bank.filters.size();
+                };
+                results.push_back(measure(opts, suite, {text("storage", storage), number("delay", delay), number("channels", numChannels)}, run));
+            }
+        }
+    }
+
+    void benchCombs(const options& opts, std::vector<measurement>& results){
+        benchFilters<basic_comb_filter<float_storage, delay_interpolation>>(opts, results, "comb_filter", "float", numcombs);
+        benchFilters<basic_comb_filter<half_storage, delay_interpolation>>(opts, results, "comb_filter", "half", numcombs);
+        benchFilters<basic_comb_filter<int16_storage, delay_interpolation>>(opts, results, "comb_filter", "int16", numcombs);
+    }
+
+    void benchAllpasses(const options& opts, std::vector<measurement>& results){
+        benchFilters<basic_allpass_filter<float_storage, delay_interpolation>>(opts, results, "allpass_filter", "float", numallpasses);
+        benchFilters<basic_allpass_filter<half_storage, delay_interpolation>>(opts, results, "allpass_filter", "half", numallpasses);
+        benchFilters<basic_allpass_filter<int16_storage, delay_interpolation>>(opts, results, "allpass_filter", "int16", numallpasses);
+    }
+
+    //==============================================================================
+    template <typename Interpolation>
+    void benchInterpolation(const options& opts, std::vector<measurement>& results, const char* name){
+        const unsigned long size = 4096;
+        const unsigned long mask = size - 1;
+        std::vector<float> buffer(size);
+        std::mt19937 rng(2);
+        std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+        for (float& sample : buffer) sample = noise(rng);
+
+        const int numReads = opts.quick ? 1 << 16 : 1 << 18;
+
+        for (float buffer_step : {0.5f, 2.f}){
+            Interpolation interpolator;
+            auto run = [&](){
+                float acc = 0.f;
+                // the read position moves like the one of a resizing delay line
+                float position = 0.f;
+                for (int i = 0; i < numReads; i++){
+                    const unsigned long idx = (unsigned long) position;
+                    acc += interpolator.template read<float_storage>(buffer.data(), mask, idx & mask, position - (float) idx, buffer_step);
+                    position += buffer_step;
+                    if (position >= (float) size) position -= (float) size;
+                }
+                sink = acc;
+                return (double) numReads;
+            };
+            results.push_back(measure(opts, "interpolation", {text("policy", name), number("buffer_step", buffer_step)}, run));
+        }
+    }
+
+    void benchInterpolations(const options& opts, std::vector<measurement>& results){
+        benchInterpolation<none_interpolation>(opts, results, "none");
+        benchInterpolation<linear_interpolation>(opts, results, "linear");
+        benchInterpolation<hermite_interpolation>(opts, results, "hermite");
+        benchInterpolation<thiran_interpolation>(opts, results, "thiran");
+        benchInterpolation<sinc_interpolation>(opts, results, "sinc");
+    }
+
+    //==============================================================================
+    std::vector<diffuse_kernels::instruction_set> supportedInstructionSets(){
+        std::vector<diffuse_kernels::instruction_set> sets;
+        for (auto set : {diffuse_kernels::instruction_set::generic, diffuse_kernels::instruction_set::sse2,
+                         diffuse_kernels::instruction_set::avx2, diffuse_kernels::instruction_set::avx512}){
+            if (diffuse_kernels::is_supported(set)) sets.push_back(set);
+        }
+        return sets;
+    }
+
+    std::vector<int> blockSizes(const options& opts){
+        return opts.quick ? std::vector<int>{16, 256, 4096} : std::vector<int>{16, 32, 64, 128, 256, 512, 1024, 2048, 4096};
+    }
+
+    void benchMix(const options& opts, std::vector<measurement>& results){
+        const int totalSamples = opts.quick ? 1 << 18 : 1 << 20;
+
+        for (auto set : supportedInstructionSets()){
+            const diffuse_kernels::kernel_table& kernels = diffuse_kernels::get_kernels(set);
+            for (int numInputs : {1, 2}){
+                for (int blockSize : blockSizes(opts)){
+                    std::vector<std::vector<float>> inputs(numInputs, std::vector<float>(blockSize, 0.25f));
+                    std::vector<const float*> pointers;
+                    for (auto& input : inputs) pointers.push_back(input.data());
+                    std::vector<float> output(blockSize);
+
+                    auto run = [&](){
+                        const int numBlocks = totalSamples / blockSize;
+                        for (int block = 0; block < numBlocks; block++) kernels.mix(pointers.data(), numInputs, output.data(), blockSize, 0.5f);
+                        sink = output[0];
+                        return (double) numBlocks * blockSize;
+                    };
+                    results.push_back(measure(opts, "mix", {text("isa", kernels.name), number("inputs", numInputs), number("block", blockSize)}, run));
+                }
+            }
+        }
+    }
+
+    void benchChannels(const options& opts, std::vector<measurement>& results){
+        const std::vector<int> channelCounts = opts.quick ? std::vector<int>{1, 63} : std::vector<int>{1, 3, 15, 35, 63};
+        const int totalSamples = opts.quick ? 1 << 13 : 1 << 15;
+        const float feedback = (initialroom*scalefeedback) + offsetfeedback;
+        const float comb_buffactor = 1 + (initialroom*scale_comb_buffer)-(scale_comb_buffer/2);
+        const float allpass_buffactor = 1 + (initialroom*scale_allpass_buffer)-(scale_allpass_buffer/2);
+        const float max_comb_buffactor = 1 + (scale_comb_buffer)-(scale_comb_buffer/2);
+        const float max_allpass_buffactor = 1 + (scale_allpass_buffer)-(scale_allpass_buffer/2);
+
+        for (auto set : supportedInstructionSets()){
+            const diffuse_kernels::kernel_table& kernels = diffuse_kernels::get_kernels(set);
+            for (int numChannels : channelCounts){
+                // the delay lines of the diffuse model as set up by prepareToPlay
+                std::vector<std::vector<comb_filter>> combs(numChannels, std::vector<comb_filter>(numcombs));
+                std::vector<std::vector<allpass_filter>> allpasses(numChannels, std::vector<allpass_filter>(numallpasses));
+                for (int i = 0; i < numChannels; i++){
+                    for (int j = 0; j < numcombs; j++){
+                        combs[i][j].initBuffer((int) ((i*spreadvalue) + (comb_buffer_tuning[j]*max_comb_buffactor)));
+                        combs[i][j].setbuffer((int) ((i*spreadvalue) + comb_buffer_tuning[j]*comb_buffactor));
+                        combs[i][j].setfeedback(feedback);
+                        combs[i][j].setdamp(initialdamp);
+                    }
+                    for (int j = 0; j < numallpasses; j++){
+                        allpasses[i][j].initBuffer((int) ((i*spreadvalue) + (allpass_buffer_tuning[j]*max_allpass_buffactor)));
+                        allpasses[i][j].setbuffer((int) ((i*spreadvalue) + allpass_buffer_tuning[j]*allpass_buffactor));
+                        allpasses[i][j].setfeedback(feedback);
+                    }
+                }
+
+                for (int blockSize : blockSizes(opts)){
+                    std::vector<float> input(blockSize, 0.f);
+                    input[0] = 1.f;
+                    std::vector<std::vector<float>> outputs(numChannels + 1, std::vector<float>(blockSize));
+                    const diffuse_kernels::channel_gains gains = {initialgain, initialwet / numcombs, 1.f / (numChannels + 1), initialdry};
+
+                    auto run = [&](){
+                        const int numBlocks = std::max(1, totalSamples / blockSize);
+                        for (int block = 0; block < numBlocks; block++){
+                            for (int channel = 0; channel < numChannels; channel++){
+                                kernels.process_channel(combs[channel].data(), numcombs, allpasses[channel].data(), numallpasses, input.data(), outputs[channel + 1].data(),
+                                                        outputs[0].data(), blockSize, gains, channel == 0);
+                            }
+                        }
+                        sink = outputs[0][0];
+                        return (double) numBlocks * blockSize * numChannels;
+                    };
+                    results.push_back(measure(opts, "process_channel", {text("isa", kernels.name), number("channels", numChannels), number("block", blockSize)}, run));
+                }
+            }
+        }
+    }
+
+    //==============================================================================
+    void writeJson(const options& opts, const std::vector<measurement>& results){
+        FILE* file = std::fopen(opts.output.c_str(), "w");
+        if (file == nullptr){
+            std::fprintf(stderr, "could not write %s\n", opts.output.c_str());
+            std::exit(1);
+        }
+
+        std::fprintf(file, "{\n  \"benchmark\": \"reverb_bench\",\n");
+        std::fprintf(file, "  \"detected_isa\": \"%s\",\n", isaName(diffuse_kernels::detect_instruction_set()));
+        std::fprintf(file, "  \"repetitions\": %d,\n", opts.repetitions);
+        std::fprintf(file, "  \"unit\": \"per sample of one filter, interpolated read or channel\",\n");
+        std::fprintf(file, "  \"results\": [\n");
+        for (size_t i = 0; i < results.size(); i++){
+            const measurement& m = results[i];
+            std::fprintf(file, "    {\"suite\": \"%s\", \"params\": {", m.suite.c_str());
+            for (size_t j = 0; j < m.parameters.size(); j++){
+                const parameter& p = m.parameters[j];
+                std::fprintf(file, p.quoted ? "%s\"%s\": \"%s\"" : "%s\"%s\": %s", j > 0 ? ", " : "", p.name.c_str(), p.value.c_str());
+            }
+            std::fprintf(file, "}, \"ns_per_sample\": %.4f, \"ns_per_sample_min\": %.4f", m.nsPerSample, m.nsPerSampleMin);
+            if (REVERB_BENCH_HAS_TSC) std::fprintf(file, ", \"cycles_per_sample\": %.4f", m.cyclesPerSample);
+            else std::fprintf(file, ", \"cycles_per_sample\": null");
+            std::fprintf(file, "}%s\n", i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(file, "  ]\n}\n");
+        std::fclose(file);
+    }
+
+    options parseOptions(int argc, char* argv[]){
+        options opts;
+        for (int i = 1; i < argc; i++){
+            const std::string arg = argv[i];
+            if (arg == "--output" && i + 1 < argc) opts.output = argv[++i];
+            else if (arg == "--repetitions" && i + 1 < argc) opts.repetitions = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--suite" && i + 1 < argc) opts.suite = argv[++i];
+            else if (arg == "--quick") opts.quick = true;
+            else{
+                std::fprintf(stderr, "usage: %s [--output file.json] [--repetitions n] [--quick] [--suite comb_filter|allpass_filter|interpolation|mix|process_channel]\n", argv[0]);
+                std::exit(arg == "--help" ? 0 : 1);
+            }
+        }
+        return opts;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const options opts = parseOptions(argc, argv);
+
+    struct suite{
+        const char* name;
+        void (*run)(const options&, std::vector<measurement>&);
+    };
+    const suite suites[] = {
+        {"comb_filter", benchCombs},
+        {"allpass_filter", benchAllpasses},
+        {"interpolation", benchInterpolations},
+        {"mix", benchMix},
+        {"process_channel", benchChannels},
+    };
+
+    std::printf("detected instruction set: %s\n", isaName(diffuse_kernels::detect_instruction_set()));
+
+    std::vector<measurement> results;
+    for (const suite& s : suites){
+        if (opts.suite.empty() || opts.suite == s.name) s.run(opts, results);
+    }
+
+    writeJson(opts, results);
+    std::printf("results written to %s\n", opts.output.c_str());
+    return 0;
+}
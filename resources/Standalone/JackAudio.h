@@ -45,8 +45,12 @@
 
   ==============================================================================
 */
+#include <atomic>
 #include <dlfcn.h>
 #include <jack/jack.h>
+#include <thread>
+
+#include "../../source/trace.h"
 
 const juce::String receiver = "BinauralDecoder";
 
@@ -192,7 +196,6 @@ public:
           inputId (inId),
           outputId (outId),
           deviceIsOpen (false),
-          callback (nullptr),
           totalNumberOfInputChannels (0),
           totalNumberOfOutputChannels (0)
     {
@@ -337,17 +340,16 @@ public:
 
     void start (juce::AudioIODeviceCallback* newCallback) override
     {
-        if (deviceIsOpen && newCallback != callback)
+        if (deviceIsOpen && newCallback != callback.load())
         {
             if (newCallback != nullptr)
                 newCallback->audioDeviceAboutToStart (this);
 
-            juce::AudioIODeviceCallback* const oldCallback = callback;
+            juce::AudioIODeviceCallback* const oldCallback = callback.exchange (newCallback);
 
-            {
-                const juce::ScopedLock sl (callbackLock);
-                callback = newCallback;
-            }
+            // The JACK thread never waits for this thread. A cycle that started before the exchange may still
+            // use the old callback, so it is only stopped once that cycle finished.
+            waitForProcessCycle();
 
             if (oldCallback != nullptr)
                 oldCallback->audioDeviceStopped();
@@ -360,7 +362,7 @@ public:
     }
 
     bool isOpen() override                           { return deviceIsOpen; }
-    bool isPlaying() override                        { return callback != nullptr; }
+    bool isPlaying() override                        { return callback.load() != nullptr; }
     int getCurrentBitDepth() override                { return 32; }
     juce::String getLastError() override                   { return lastError; }
     int getXRunCount() const noexcept override       { return xruns; }
@@ -388,11 +390,33 @@ public:
         return latency;
     }
 
+    /** Waits until a process cycle that was running when the callback was exchanged has finished, never called by the JACK thread.
+
+        The epoch is incremented before the JACK thread loads the callback and after it is done with it, both
+        sequentially consistent like the exchange in start. So either the cycle sees the new callback, or the epoch
+        read here is odd and the cycle that may use the old one ends with the next increment. The same holds for
+        anything else the callback loads sequentially consistent and that was stored that way before this call.
+    */
+    void waitForProcessCycle()
+    {
+        const auto epoch = processEpoch.load();
+
+        if ((epoch & 1) == 0)
+            return;
+
+        // without a client a cycle cut off by the shutdown of the server never ends
+        while (processEpoch.load() == epoch && client != nullptr)
+            std::this_thread::yield();
+    }
+
     juce::String inputId, outputId;
 
 private:
     void process (const int numSamples)
     {
+        REVERB_TRACE_THREAD_NAME ("JACK process");
+        REVERB_TRACE_SCOPE ("JACK process");
+
         int numActiveInChans = 0, numActiveOutChans = 0;
 
         for (int i = 0; i < totalNumberOfInputChannels; ++i)
@@ -411,19 +435,22 @@ private:
                     outChans [numActiveOutChans++] = (float*) out;
         }
 
-        const juce::ScopedLock sl (callbackLock);
+        // odd while the cycle may use the callback, see waitForProcessCycle
+        processEpoch.fetch_add (1);
 
-        if (callback != nullptr)
+        if (auto* currentCallback = callback.load())
         {
             if ((numActiveInChans + numActiveOutChans) > 0)
-                callback->audioDeviceIOCallback (const_cast<const float**> (inChans.getData()), numActiveInChans,
-                                                 outChans, numActiveOutChans, numSamples);
+                currentCallback->audioDeviceIOCallback (const_cast<const float**> (inChans.getData()), numActiveInChans,
+                                                        outChans, numActiveOutChans, numSamples);
         }
         else
         {
             for (int i = 0; i < numActiveOutChans; ++i)
                 juce::zeromem (outChans[i], sizeof (float) * numSamples);
         }
+
+        processEpoch.fetch_add (1);
     }
 
     static int processCallback (jack_nframes_t nframes, void* callbackArgument)
@@ -436,6 +463,8 @@ private:
 
     static int xrunCallback (void* callbackArgument)
     {
+        REVERB_TRACE_INSTANT ("JACK xrun");
+
         if (callbackArgument != nullptr)
             ((JackAudioIODevice*) callbackArgument)->xruns++;
 
@@ -489,8 +518,10 @@ private:
     bool deviceIsOpen;
     jack_client_t* client;
     juce::String lastError;
-    juce::AudioIODeviceCallback* callback;
-    juce::CriticalSection callbackLock;
+    // exchanged by start on the message thread, loaded once per cycle by the JACK thread
+    std::atomic<juce::AudioIODeviceCallback*> callback { nullptr };
+    // incremented by the JACK thread at the start and the end of every cycle
+    std::atomic<uint64_t> processEpoch { 0 };
 
     juce::HeapBlock<float*> inChans, outChans;
     int totalNumberOfInputChannels;
@@ -498,7 +529,8 @@ private:
     juce::Array<const jack_port_t *> inputPorts, outputPorts;
     juce::BigInteger activeInputChannels, activeOutputChannels;
 
-    int xruns;
+    // incremented by the JACK thread, read by getXRunCount from any thread
+    std::atomic<int> xruns { 0 };
 };
 
 
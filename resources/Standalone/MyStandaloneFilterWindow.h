@@ -52,6 +52,7 @@
 
 #include "../../source/LookAndFeel_frqz_rm.h"
 #include "../../source/SimpleLabel.h"
+#include "../../source/telemetry.h"
 #include "IEM_AudioDeviceSelectorComponent.h"
 
 #if JUCE_MAC || JUCE_LINUX
@@ -121,6 +122,9 @@ public:
           shouldMuteInput (! isInterAppAudioConnected()),
           autoOpenMidiDevices (shouldAutoOpenMidiDevices)
     {
+        if (preferredSetupOptions != nullptr)
+            options.reset (new juce::AudioDeviceManager::AudioDeviceSetup (*preferredSetupOptions));
+
         createPlugin();
 
         juce::OwnedArray<juce::AudioIODeviceType> types;
@@ -138,9 +142,6 @@ public:
         auto inChannels = (channelConfiguration.size() > 0 ? channelConfiguration[0].numIns
                                                            : processor->getMainBusNumInputChannels());
 
-        if (preferredSetupOptions != nullptr)
-            options.reset (new juce::AudioDeviceManager::AudioDeviceSetup (*preferredSetupOptions));
-
         auto audioInputRequired = (inChannels > 0);
 
         if (audioInputRequired && juce::RuntimePermissions::isRequired (juce::RuntimePermissions::recordAudio)
@@ -157,8 +158,14 @@ public:
         reloadPluginState();
         startPlaying();
 
-       if (autoOpenMidiDevices)
-           startTimer (500);
+        // the timer publishes the telemetry and checks for new MIDI devices if enabled
+        if (! telemetryPublisher.open())
+            std::cout << "telemetry: shared memory is not available" << std::endl;
+
+        REVERB_TRACE_THREAD_NAME ("message");
+        trace::install_signal_handler();
+
+        startTimer (telemetryInterval);
     }
 
     virtual ~MyStandalonePluginHolder() override
@@ -182,7 +189,9 @@ public:
         jassert (processor != nullptr); // Your createPluginFilter() function must return a valid object!
 
         processor->disableNonMainBuses();
-        processor->setRateAndBufferSizeDetails (44100, 512);
+        // the device calls prepareToPlay with its own settings when it starts, until then the preferred ones are the best guess
+        processor->setRateAndBufferSizeDetails (options != nullptr && options->sampleRate > 0 ? options->sampleRate : 44100,
+                                                options != nullptr && options->bufferSize > 0 ? options->bufferSize : 512);
 
         int inChannels = (channelConfiguration.size() > 0 ? channelConfiguration[0].numIns
                                                           : processor->getMainBusNumInputChannels());
@@ -282,6 +291,7 @@ public:
     void startPlaying()
     {
         player.setProcessor (processor.get());
+        directProcessor.store (dynamic_cast<ProcessorClass*> (processor.get()), std::memory_order_release);
 
        #if JucePlugin_Enable_IAA && JUCE_IOS
         if (auto device = dynamic_cast<iOSAudioIODevice*> (deviceManager.getCurrentAudioDevice()))
@@ -294,6 +304,23 @@ public:
 
     void stopPlaying()
     {
+        // sequentially consistent like the load in audioDeviceIOCallback, see JackAudioIODevice::waitForProcessCycle
+        directProcessor.store (nullptr);
+
+        // waits for a callback that still processes with the old processor
+       #if BUILD_WITH_JACK_SUPPORT
+        if (auto* jack = dynamic_cast<JackAudioIODevice*> (deviceManager.getCurrentAudioDevice()))
+        {
+            // the JACK thread takes the callback lock in every cycle, holding it here would stall the cycle
+            jack->waitForProcessCycle();
+        }
+        else
+       #endif
+        {
+            // the other device types are driven by JUCE, which waits for their callbacks with this lock itself
+            const juce::ScopedLock sl (deviceManager.getAudioCallbackLock());
+        }
+
         player.setProcessor (nullptr);
     }
 
@@ -460,6 +487,9 @@ public:
     bool processorHasPotentialFeedbackLoop = true;
     juce::Value shouldMuteInput;
     juce::AudioBuffer<float> emptyBuffer;
+    /** The processor the device callback calls directly, see audioDeviceIOCallback. */
+    std::atomic<ProcessorClass*> directProcessor { nullptr };
+    juce::MidiBuffer directMidi;
     bool autoOpenMidiDevices;
 
     std::unique_ptr<juce::AudioDeviceManager::AudioDeviceSetup> options;
@@ -467,6 +497,12 @@ public:
 
     juce::String jackClientName = "";
 
+    /// ms between two telemetry updates, the MIDI devices are checked every 500 ms
+    static constexpr int telemetryInterval = 100;
+    telemetry::publisher telemetryPublisher;
+    telemetry::counters telemetryCounters {};
+    int timerTicks = 0;
+
 private:
     //==============================================================================
     class SettingsComponent : public juce::Component
@@ -546,6 +582,9 @@ private:
                                 int numOutputChannels,
                                 int numSamples) override
     {
+        REVERB_TRACE_THREAD_NAME ("audio");
+        REVERB_TRACE_SCOPE ("audio device callback");
+
         const bool inputMuted = shouldMuteInput.getValue();
 
         if (inputMuted)
@@ -554,6 +593,35 @@ private:
             inputChannelData = emptyBuffer.getArrayOfReadPointers();
         }
 
+        // The device buffers go straight to the processor when they match its configuration, the
+        // AudioProcessorPlayer would gather them into an AudioBuffer of its own first. The load is sequentially
+        // consistent for the handshake in stopPlaying.
+        auto* reverb = directProcessor.load();
+
+        if (reverb != nullptr
+            && reverb->getTotalNumInputChannels() == numInputChannels
+            && reverb->getTotalNumOutputChannels() == numOutputChannels
+            && numSamples <= reverb->getBlockSize())
+        {
+            // the MIDI is not used, but the collector must not fill up
+            directMidi.clear();
+            player.getMidiMessageCollector().removeNextBlockOfMessages (directMidi, numSamples);
+
+            const juce::ScopedLock sl (reverb->getCallbackLock());
+
+            if (reverb->isSuspended())
+            {
+                for (int i = 0; i < numOutputChannels; ++i)
+                    juce::FloatVectorOperations::clear (outputChannelData[i], numSamples);
+            }
+            else
+            {
+                reverb->processdirect (inputChannelData, outputChannelData, numSamples);
+            }
+
+            return;
+        }
+
         player.audioDeviceIOCallback (inputChannelData, numInputChannels,
                                       outputChannelData, numOutputChannels, numSamples);
     }
@@ -562,6 +630,7 @@ private:
     {
         emptyBuffer.setSize (device->getActiveInputChannels().countNumberOfSetBits(), device->getCurrentBufferSizeSamples());
         emptyBuffer.clear();
+        directMidi.ensureSize (2048);
 
         player.audioDeviceAboutToStart (device);
         player.setMidiOutput (deviceManager.getDefaultMidiOutput());
@@ -598,8 +667,51 @@ private:
         deviceManager.removeAudioCallback (this);
     }
 
+    void publishTelemetry()
+    {
+        auto* reverb = dynamic_cast<ProcessorClass*> (processor.get());
+
+        if (! telemetryPublisher.is_open() || reverb == nullptr)
+            return;
+
+        auto& counters = telemetryCounters;
+        auto* device = deviceManager.getCurrentAudioDevice();
+        const juce::String deviceName = device != nullptr ? device->getTypeName() + ": " + device->getName() : juce::String ("none");
+
+        counters.active_channels = reverb->getactivechannels();
+        counters.sample_rate = reverb->getSampleRate();
+        counters.block_size = reverb->getBlockSize();
+        counters.resize_in_progress = reverb->getresizeinprogress() ? 1 : 0;
+        counters.freeze = reverb->getfreezemode() ? 1 : 0;
+        counters.quality_tier = reverb->getqualitytier();
+        counters.xruns = device != nullptr ? device->getXRunCount() : 0;
+        counters.update_time_ms = (uint64_t) juce::Time::currentTimeMillis();
+        counters.denormal_samples = reverb->getdenormalsamples();
+        counters.non_finite_samples = reverb->getnonfinitesamples();
+        deviceName.copyToUTF8 (counters.device, sizeof (counters.device));
+        juce::String (reverb->getkernelsname()).copyToUTF8 (counters.kernels, sizeof (counters.kernels));
+        counters.load = reverb->getloadmonitor().get_statistics();
+        reverb->getloadmonitor().get_bucket_counts (counters.load_histogram);
+        counters.perf = reverb->getperfcounters().get_statistics();
+
+        telemetryPublisher.publish (counters);
+    }
+
     void timerCallback() override
     {
+        publishTelemetry();
+
+        if (trace::dump_requested())
+        {
+            const juce::String path = juce::File::getSpecialLocation (juce::File::tempDirectory)
+                                          .getChildFile ("reverb-trace-" + juce::Time::getCurrentTime().formatted ("%Y%m%d-%H%M%S") + ".json")
+                                          .getFullPathName();
+            std::cout << (trace::dump (path.toRawUTF8()) ? "trace written to " : "could not write the trace to ") << path << std::endl;
+        }
+
+        if (! autoOpenMidiDevices || ++timerTicks % (500 / telemetryInterval) != 0)
+            return;
+
         auto newMidiDevices = juce::MidiInput::getDevices();
 
         if (newMidiDevices != lastMidiDevices)
@@ -57,11 +57,109 @@ extern juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
 
 #include "MyStandaloneFilterWindow.h"
 
+#include <csignal>
+
 namespace juce
 {
 
 //==============================================================================
-class StandaloneApp  : public JUCEApplication
+/**
+    Settings of the headless mode, taken from the command line.
+
+    With --headless the app runs without a window: the audio device, the initial
+    parameters and a state file are given on the command line, the state is saved
+    to the file again on exit. SIGINT and SIGTERM quit the app cleanly.
+*/
+struct HeadlessOptions
+{
+    bool headless = false;
+    /** The audio device type, e.g. JACK or ALSA, empty for the default. */
+    juce::String deviceType;
+    juce::String deviceName;
+    double sampleRate = 0.0;
+    int bufferSize = 0;
+    /** The ambisonic order, sets the number of output channels, -1 for the device default. */
+    int order = -1;
+    /** The lowest quality tier the quality governor may select, 0 disables it, -1 for the default. */
+    int maxQualityTier = -1;
+    /** Runs the high orders with fewer filters, see reduced_detail_combs in tuning.h. */
+    bool reducedDetail = false;
+    bool muteInput = false;
+    juce::Array<std::pair<juce::String, float>> parameters;
+    juce::File stateFile;
+    juce::String error;
+
+    static juce::String getUsage()
+    {
+        return "usage: Reverb --headless [--device-type JACK|ALSA|...] [--device name] [--sample-rate hz] [--buffer-size samples]\n"
+               "                         [--order 0-7] [--room 0-1] [--damp 0-1] [--wet 0-1] [--dry 0-1] [--freeze 0|1]\n"
+               "                         [--max-quality-tier 0-" + juce::String (numqualitytiers - 1) + "] [--detail full|reduced]\n"
+               "                         [--state file] [--mute-input]\n";
+    }
+
+    static HeadlessOptions parse (const juce::StringArray& args)
+    {
+        HeadlessOptions options;
+        options.headless = args.contains ("--headless");
+
+        for (int i = 0; i < args.size() && options.error.isEmpty(); ++i)
+        {
+            const auto& arg = args[i];
+            const bool hasValue = i + 1 < args.size();
+            const auto value = hasValue ? args[i + 1] : juce::String();
+
+            auto addParameter = [&] (const char* parameterID, bool isToggle)
+            {
+                const float v = value.getFloatValue();
+
+                if (! hasValue || (! isToggle && (v < 0.0f || v > 1.0f)))
+                    options.error = arg + " needs a value between 0 and 1";
+                else
+                    options.parameters.add ({ parameterID, isToggle ? (v > 0.5f ? 1.0f : 0.0f) : v });
+
+                ++i;
+            };
+
+            if (arg == "--headless")            continue;
+            else if (arg == "--mute-input")     options.muteInput = true;
+            else if (arg == "--room")           addParameter (PARAM_ROOM_SIZE_ID, false);
+            else if (arg == "--damp")           addParameter (PARAM_DAMP_ID, false);
+            else if (arg == "--wet")            addParameter (PARAM_WET_ID, false);
+            else if (arg == "--dry")            addParameter (PARAM_DRY_ID, false);
+            else if (arg == "--freeze")         addParameter (PARAM_FREEZE_ID, true);
+            else if (! hasValue)                options.error = "unknown option " + arg;
+            else
+            {
+                if (arg == "--device-type")         options.deviceType = value;
+                else if (arg == "--device")         options.deviceName = value;
+                else if (arg == "--sample-rate")    options.sampleRate = value.getDoubleValue();
+                else if (arg == "--buffer-size")    options.bufferSize = value.getIntValue();
+                else if (arg == "--order")          options.order = value.getIntValue();
+                else if (arg == "--max-quality-tier") options.maxQualityTier = value.getIntValue();
+                else if (arg == "--detail" && (value == "full" || value == "reduced")) options.reducedDetail = value == "reduced";
+                else if (arg == "--state")          options.stateFile = juce::File::getCurrentWorkingDirectory().getChildFile (value);
+                else                                options.error = "unknown option " + arg;
+
+                ++i;
+            }
+        }
+
+        if (options.error.isEmpty() && (options.maxQualityTier < -1 || options.maxQualityTier >= numqualitytiers))
+            options.error = "--max-quality-tier needs a value between 0 and " + juce::String (numqualitytiers - 1);
+
+        if (options.error.isEmpty() && (options.order < -1 || options.order > 7))
+            options.error = "the order must be between 0 and 7";
+
+        return options;
+    }
+};
+
+/** Set by SIGINT and SIGTERM in the headless mode. */
+static volatile std::sig_atomic_t headlessQuitRequested = 0;
+
+//==============================================================================
+class StandaloneApp  : public JUCEApplication,
+                       private Timer
 {
 public:
     StandaloneApp()
@@ -111,6 +209,23 @@ public:
     //==============================================================================
     void initialise (const juce::String&) override
     {
+        const auto args = getCommandLineParameterArray();
+
+        if (args.contains ("--help") || args.contains ("-h"))
+        {
+            std::cout << HeadlessOptions::getUsage();
+            quit();
+            return;
+        }
+
+        headlessOptions = HeadlessOptions::parse (args);
+
+        if (headlessOptions.headless)
+        {
+            startHeadless();
+            return;
+        }
+
         mainWindow.reset (createWindow());
 
        #if JUCE_STANDALONE_FILTER_WINDOW_USE_KIOSK_MODE
@@ -122,6 +237,18 @@ public:
 
     void shutdown() override
     {
+        stopTimer();
+
+        if (headlessHolder != nullptr && headlessOptions.stateFile != juce::File())
+        {
+            juce::MemoryBlock data;
+            headlessHolder->processor->getStateInformation (data);
+
+            if (data.getSize() > 0 && ! headlessOptions.stateFile.replaceWithData (data.getData(), data.getSize()))
+                std::cerr << "could not write the state to " << headlessOptions.stateFile.getFullPathName() << std::endl;
+        }
+
+        headlessHolder = nullptr;
         mainWindow = nullptr;
         appProperties.saveIfNeeded();
     }
@@ -144,8 +271,136 @@ public:
     }
 
 protected:
+    //==============================================================================
+    /** Runs the plugin without a window, configured by the command line. */
+    void startHeadless()
+    {
+        if (headlessOptions.error.isNotEmpty())
+        {
+            std::cerr << headlessOptions.error << std::endl << HeadlessOptions::getUsage();
+            setApplicationReturnValue (1);
+            quit();
+            return;
+        }
+
+        // The device settings of the window are not used, the command line is the whole configuration.
+        juce::AudioDeviceManager::AudioDeviceSetup preferredSetup;
+        preferredSetup.sampleRate = headlessOptions.sampleRate;
+        preferredSetup.bufferSize = headlessOptions.bufferSize;
+
+        headlessHolder.reset (new MyStandalonePluginHolder (nullptr, false, headlessOptions.deviceName, &preferredSetup));
+        headlessHolder->getMuteInputValue().setValue (headlessOptions.muteInput);
+
+        const auto error = configureHeadlessDevice();
+
+        if (error.isNotEmpty())
+        {
+            std::cerr << error << std::endl;
+            setApplicationReturnValue (1);
+            quit();
+            return;
+        }
+
+        auto* reverb = dynamic_cast<ProcessorClass*> (headlessHolder->processor.get());
+        juce::MemoryBlock data;
+
+        if (headlessOptions.stateFile.existsAsFile() && headlessOptions.stateFile.loadFileAsData (data))
+            headlessHolder->processor->setStateInformation (data.getData(), (int) data.getSize());
+
+        // the parameters on the command line override the state file
+        for (auto& parameter : headlessOptions.parameters)
+            if (auto* p = reverb != nullptr ? reverb->parameters.getParameter (parameter.first) : nullptr)
+                p->setValueNotifyingHost (p->convertTo0to1 (parameter.second));
+
+        if (reverb != nullptr && headlessOptions.reducedDetail)
+        {
+            ProcessorClass::detail_profile profile;
+            std::copy (std::begin (reduced_detail_combs), std::end (reduced_detail_combs), profile.combs);
+            std::copy (std::begin (reduced_detail_allpasses), std::end (reduced_detail_allpasses), profile.allpasses);
+            reverb->setdetailprofile (profile);
+        }
+
+        if (reverb != nullptr && headlessOptions.maxQualityTier >= 0)
+        {
+            auto governor = reverb->getqualitygovernor();
+            governor.enabled = headlessOptions.maxQualityTier > 0;
+            governor.max_tier = headlessOptions.maxQualityTier;
+            reverb->setqualitygovernor (governor);
+        }
+
+        if (auto* device = headlessHolder->deviceManager.getCurrentAudioDevice())
+            std::cout << "headless: " << device->getTypeName() << " " << device->getName() << ", "
+                      << device->getCurrentSampleRate() << " Hz, " << device->getCurrentBufferSizeSamples() << " samples, "
+                      << device->getActiveOutputChannels().countNumberOfSetBits() << " output channels" << std::endl;
+
+        std::signal (SIGINT,  [] (int) { headlessQuitRequested = 1; });
+        std::signal (SIGTERM, [] (int) { headlessQuitRequested = 1; });
+        startTimer (100);
+    }
+
+    /** Switches to the device type of the command line and applies the device settings, returns an error message. */
+    juce::String configureHeadlessDevice()
+    {
+        auto& deviceManager = headlessHolder->deviceManager;
+
+        if (headlessOptions.deviceType.isNotEmpty())
+        {
+            juce::String typeName;
+
+            for (auto* type : deviceManager.getAvailableDeviceTypes())
+                if (type->getTypeName().equalsIgnoreCase (headlessOptions.deviceType))
+                    typeName = type->getTypeName();
+
+            if (typeName.isEmpty())
+                return "unknown device type " + headlessOptions.deviceType;
+
+            if (deviceManager.getCurrentAudioDeviceType() != typeName)
+                deviceManager.setCurrentAudioDeviceType (typeName, true);
+        }
+
+        auto setup = deviceManager.getAudioDeviceSetup();
+
+        if (headlessOptions.deviceName.isNotEmpty())
+            setup.inputDeviceName = setup.outputDeviceName = headlessOptions.deviceName;
+
+        if (headlessOptions.sampleRate > 0.0)
+            setup.sampleRate = headlessOptions.sampleRate;
+
+        if (headlessOptions.bufferSize > 0)
+            setup.bufferSize = headlessOptions.bufferSize;
+
+        if (headlessOptions.order >= 0)
+        {
+            const int numChannels = (headlessOptions.order + 1) * (headlessOptions.order + 1);
+            setup.useDefaultOutputChannels = false;
+            setup.outputChannels.clear();
+            setup.outputChannels.setRange (0, numChannels, true);
+        }
+
+        const auto error = deviceManager.setAudioDeviceSetup (setup, true);
+
+        if (error.isNotEmpty())
+            return error;
+
+        if (deviceManager.getCurrentAudioDevice() == nullptr)
+            return "no audio device could be opened";
+
+        return {};
+    }
+
+    void timerCallback() override
+    {
+        if (headlessQuitRequested != 0)
+        {
+            stopTimer();
+            quit();
+        }
+    }
+
     ApplicationProperties appProperties;
     std::unique_ptr<MyStandaloneFilterWindow> mainWindow;
+    HeadlessOptions headlessOptions;
+    std::unique_ptr<MyStandalonePluginHolder> headlessHolder;
 };
 
 } // namespace juce
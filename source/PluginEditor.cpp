@@ -99,6 +99,11 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor (AudioPluginAud
     drySliderAttachement = std::make_unique<Attachment>(*parameters.getParameter(PARAM_DRY_ID), main.sliders.drySlider);
     dampeningSliderAttachement = std::make_unique<Attachment>(*parameters.getParameter(PARAM_DAMP_ID), main.sliders.dampeningSlider);
     roomsizeSliderAttachement = std::make_unique<Attachment>(*parameters.getParameter(PARAM_ROOM_SIZE_ID), main.sliders.roomsizeSlider);
+    
+    addAndMakeVisible(qualityLabel);
+    qualityLabel.setJustificationType(juce::Justification::centredRight);
+    timerCallback();
+    startTimerHz(4);
 }
 
 AudioPluginAudioProcessorEditor::~AudioPluginAudioProcessorEditor()
@@ -120,4 +125,11 @@ void AudioPluginAudioProcessorEditor::resized()
     // subcomponents in your editor..
     auto edge = 20;
     main.setBounds(edge, edge, getWidth()-2*edge, getHeight()-2*edge);
+    qualityLabel.setBounds(edge, getHeight()-edge-20, getWidth()-2*edge, 20);
+}
+
+void AudioPluginAudioProcessorEditor::timerCallback()
+{
+    const int tier = processorRef.getqualitytier();
+    qualityLabel.setText(tier == 0 ? "full quality" : "reduced quality, tier " + juce::String(tier), juce::dontSendNotification);
 }
@@ -42,7 +42,8 @@ private:
 
 
 //==============================================================================
-class AudioPluginAudioProcessorEditor  : public juce::AudioProcessorEditor
+class AudioPluginAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                         private juce::Timer
 {
 public:
     explicit AudioPluginAudioProcessorEditor (AudioPluginAudioProcessor&);
@@ -58,10 +59,14 @@ public:
     std::unique_ptr<juce::SliderParameterAttachment> roomsizeSliderAttachement;
 
 private:
+    /// shows the quality tier the quality_governor selected
+    void timerCallback() override;
+    
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     AudioPluginAudioProcessor& processorRef;
     MainContentComponent main;
+    juce::Label qualityLabel;
     LaF LookAndFeel_frqz_rm;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioPluginAudioProcessorEditor)
@@ -1,5 +1,42 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#if ! JUCE_WINDOWS
+    #include <sys/mman.h>
+#endif
+
+/// \brief Copies the snapshots the audio thread captures into the snapshot file, so that the audio thread never writes to the file mapping
+class AudioPluginAudioProcessor::snapshot_writer : public juce::Thread
+{
+public:
+    explicit snapshot_writer(AudioPluginAudioProcessor& owner) : juce::Thread("snapshot writer"), processor(owner) {}
+    
+    void run() override
+    {
+        // the audio thread cannot signal without locking, so the captures are picked up by polling
+        while (not threadShouldExit()){
+            wait(100);
+            processor.persistSnapshots();
+        }
+        processor.persistSnapshots();
+    }
+    
+private:
+    AudioPluginAudioProcessor& processor;
+};
+
+namespace
+{
+    /// identifies delay_storage in the snapshot_header
+    constexpr uint32_t snapshotStorage = std::is_same<delay_storage, float_storage>::value ? 1
+                                       : std::is_same<delay_storage, half_storage>::value ? 2
+                                       : std::is_same<delay_storage, int16_storage>::value ? 3 : 0;
+    /// identifies delay_interpolation in the snapshot_header
+    constexpr uint32_t snapshotInterpolation = std::is_same<delay_interpolation, none_interpolation>::value ? 1
+                                             : std::is_same<delay_interpolation, linear_interpolation>::value ? 2
+                                             : std::is_same<delay_interpolation, hermite_interpolation>::value ? 3
+                                             : std::is_same<delay_interpolation, thiran_interpolation>::value ? 4
+                                             : std::is_same<delay_interpolation, sinc_interpolation>::value ? 5 : 0;
+}
 
 //==============================================================================
 AudioPluginAudioProcessor::AudioPluginAudioProcessor()
@@ -20,6 +57,16 @@ AudioPluginAudioProcessor::AudioPluginAudioProcessor()
        })
 {
     for (auto & parameterID : parameterIDs) parameters.addParameterListener(parameterID, this);
+    for (int order = 0; order < plugin_state::detail_orders; order++){
+        detailCombs[order].store(detail_profile_combs[order]);
+        detailAllpasses[order].store(detail_profile_allpasses[order]);
+    }
+    // In a host the quality must not change behind the user's back, the standalone app lowers it instead of dropping out.
+    if (wrapperType == wrapperType_Standalone){
+        quality_governor::settings settings = governor.get_settings();
+        settings.enabled = true;
+        governor.set_settings(settings);
+    }
 }
 
 AudioPluginAudioProcessor::~AudioPluginAudioProcessor()
@@ -27,6 +74,7 @@ AudioPluginAudioProcessor::~AudioPluginAudioProcessor()
     for (auto & parameterID : parameterIDs) {
         if (parameterID != PARAM_ROOM_SIZE_ID) parameters.removeParameterListener(parameterID, this);
     }
+    freeSnapshots();
 }
 
 //==============================================================================
@@ -99,50 +147,41 @@ void AudioPluginAudioProcessor::prepareToPlay (double sampleRate, int samplesPer
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
-    juce::ignoreUnused (sampleRate, samplesPerBlock);
+    REVERB_TRACE_SCOPE("prepareToPlay");
     
+    // prepareToPlay is called again whenever the host changes the sample rate, block size or layout
     numInputChannels = getTotalNumInputChannels();
-    inputBuffer.setSize(1, samplesPerBlock);
-    
     numOutputChannels = getTotalNumOutputChannels();
+    model.prepare(numInputChannels, numOutputChannels, sampleRate, samplesPerBlock);
+    DBG("diffuse kernels: " << model.getkernels().name);
     
-    ACN_normalization = new float [numOutputChannels];
-    sum_ACN_normalization = 0.f;
+    loadMonitor.prepare(sampleRate);
+    governor.prepare(sampleRate);
+    snapshotSampleRate = sampleRate;
+    detailChanged.store(false);
+    applyQualityTier(0);
+    // the filters start muted, there is nothing to fade from
+    model.reset();
+    perfCounters.prepare();
+    resizeInProgress.store(false);
+    denormalSamples.store(0);
+    nonFiniteSamples.store(0);
+    abnormalCheckChannel = 1;
     
-    comb= new comb_filter * [numOutputChannels-1];
-    comb_buffer_size = new int * [numOutputChannels-1];
-    allpass = new allpass_filter * [numOutputChannels-1];
-    allpass_buffer_size = new int * [numOutputChannels-1];
-    for (int i = 0; i < numOutputChannels-1; i++){
-        comb[i] = new comb_filter [numcombs];
-        comb_buffer_size[i] = new int [numcombs];
-        allpass[i] = new allpass_filter [numallpasses];
-        allpass_buffer_size[i] = new int [numallpasses];
-        for (int j = 0; j < numcombs; j++){
-            max_comb_buffactor = (1 + (scale_comb_buffer)-(scale_comb_buffer/2));
-            comb_buffer_size[i][j] = 0;
-            comb_buffer_size[i][j] = (int) ((i*spreadvalue) + (comb_buffer_tuning[j]*max_comb_buffactor));
-            comb[i][j].initBuffer(comb_buffer_size[i][j]);
-            std::cout << comb[i][j].ready() << std::endl;
-        }
-        for (int j = 0; j < numallpasses; j++){
-            max_allpass_buffactor = (1 + (scale_allpass_buffer)-(scale_allpass_buffer/2));
-            allpass_buffer_size[i][j] = 0;
-            allpass_buffer_size[i][j] = (int) ((i*spreadvalue) + (allpass_buffer_tuning[j]*max_allpass_buffactor));
-            allpass[i][j].initBuffer(allpass_buffer_size[i][j]);
-            std::cout << allpass[i][j].ready() << std::endl;
-        }
-    }
+    // The parameters may have been restored by setStateInformation before the first prepareToPlay. The room size
+    // goes first, so that a frozen model keeps the unity feedback of the freeze.
+    const plugin_state::values state = getparameterstate();
+    setwet(state.wet);
+    setdry(state.dry);
+    setdamp(state.damp);
+    setroomsize(state.room);
+    model.requestroomsize(state.room);
+    setfreezemode(state.freeze);
     
-    setwet(initialwet);
-    setdry(initialdry);
-    setdamp(initialdamp);
-    setfreezemode(initialfreeze);
-    SN3D_normalization(numOutputChannels);
-    setroomsize(initialroom);
+    allocateSnapshots();
     
-    std::cout << "number Output Channels: " << numOutputChannels << std::endl;
-    std::cout << "number Input Channels: " << numInputChannels << std::endl;
+    DBG("number Output Channels: " << numOutputChannels);
+    DBG("number Input Channels: " << numInputChannels);
 }
 
 void AudioPluginAudioProcessor::releaseResources()
@@ -151,6 +190,13 @@ void AudioPluginAudioProcessor::releaseResources()
     // spare memory, etc.
 }
 
+void AudioPluginAudioProcessor::reset()
+{
+    REVERB_TRACE_SCOPE("reset");
+    model.reset();
+    resizeInProgress.store(false);
+}
+
 bool AudioPluginAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
     return true;
@@ -179,64 +225,38 @@ bool AudioPluginAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
 void AudioPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                                               juce::MidiBuffer&)
 {
+    // the inputs are the first channels of the buffer, the mono downmix reads them before any output is written
+    processdirect(buffer.getArrayOfReadPointers(), buffer.getArrayOfWritePointers(), buffer.getNumSamples());
+}
+
+void AudioPluginAudioProcessor::processdirect(const float* const* inputs, float* const* outputs, int numSamples)
+{
+    const uint64_t blockStart = block_load_monitor::read_ticks();
+    REVERB_TRACE_SCOPE("processBlock");
     juce::ScopedNoDenormals noDenormals;
+    serveSnapshotRequest();
+    if (model.canapplyqualitytier() && (detailChanged.exchange(false, std::memory_order_acquire) || governor.get_tier() != qualityTier))
+        applyQualityTier(governor.get_tier());
     
-    inputBuffer.clear();
-    
-    for(int channel=0; channel<numInputChannels; channel++) {
-        inputBuffer.addFrom(0, 0, buffer, channel, 0, buffer.getNumSamples());
-    }
-    
-    auto readinPointer = inputBuffer.getReadPointer(0);
-    auto readoutPointerACN0 = buffer.getReadPointer(0);
-    auto writePointerACN0 = buffer.getWritePointer(0);
+    const bool countStages = perfCounters.begin_block();
     
-    buffer.clear();
+    model.downmix(inputs, numSamples);
     
-    inputBuffer.applyGain(1.f/(float) numInputChannels);
-    
-    for(int channel=1; channel<numOutputChannels; channel++)
-    {
-        auto* readoutPointer = buffer.getReadPointer(channel);
-        auto* writePointer = buffer.getWritePointer(channel);
-
-        for(int sample = 0; sample < buffer.getNumSamples(); ++sample)
-        {
-
-            writePointer[sample] = 0;
-
-            for(int j = 0; j<numcombs; j++){
-                writePointer[sample] += comb[channel-1][j].process(gain*readinPointer[sample]);
-            }
-            for(int j = 0; j<numallpasses; j++){
-                writePointer[sample] = allpass[channel-1][j].process(readoutPointer[sample]);
-            }
-            writePointer[sample] = (wet_factor * readoutPointer[sample]) * ACN_normalization[channel];
-            writePointerACN0[sample] += writePointer[sample];
-        }
+    if (countStages) {
+        perfCounters.end_stage(perf_counters::mixing);
+        model.processstages(outputs, numSamples, &perfCounters);
+        perfCounters.end_block();
     }
-    
-
-    for(int sample = 0; sample < buffer.getNumSamples(); ++sample)
-    {
-        writePointerACN0[sample] = readoutPointerACN0[sample] / sum_ACN_normalization + dry * readinPointer[sample] * ACN_normalization[0];
+    else {
+        model.process(outputs, numSamples);
     }
     
-    if (newroom != oldroom){
-        bool ready = true;
-        for (int i = 0; i < numOutputChannels-1; i++){
-            for (int j = 0; j < numcombs; j++){
-                if (not comb[i][j].ready()) ready = false;
-                std::cout << comb[i][j].ready() << std::endl;
-            }
-            for (int j = 0; j < numallpasses; j++){
-                if (not allpass[i][j].ready()) ready = false;
-                std::cout << allpass[i][j].ready() << std::endl;
-            }
-        }
-        if (ready == true) setroomsize(newroom);
-        else if (newroom != oldroom) std::cout << "Not ready!" << std::endl;
-    }
+    finishBlock(outputs, numSamples);
+    
+    const uint64_t blockTicks = block_load_monitor::read_ticks() - blockStart;
+    loadMonitor.record(blockTicks, numSamples);
+    // offline renders keep their quality, they have no deadline
+    if (not isNonRealtime()) governor.record(blockTicks, numSamples);
 }
 
 //==============================================================================
@@ -254,26 +274,62 @@ juce::AudioProcessorEditor* AudioPluginAudioProcessor::createEditor()
 //==============================================================================
 void AudioPluginAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-    juce::ignoreUnused (destData);
+    // encoded on the stack, the only allocation is the one of the host's memory block
+    const plugin_state::values state = getparameterstate();
+    uint8_t encoded[plugin_state::maximum_size];
+    destData.replaceAll(encoded, plugin_state::write(state, encoded));
 }
 
 void AudioPluginAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
-    juce::ignoreUnused (data, sizeInBytes);
+    plugin_state::values state = getparameterstate();
+    if (data == nullptr || sizeInBytes <= 0 || not plugin_state::read(data, (size_t) sizeInBytes, state)) return;
+    
+    // The state takes the path of automation: the parameter values are stored atomically and parameterChanged only
+    // runs for the parameters that changed, so recalling the current preset costs nothing. A new room size is only
+    // taken over by processBlock once the delay lines finished the running resize, they glide to the new length
+    // instead of jumping, so a recall during playback does not click.
+    auto recall = [this] (const char* parameterID, float value) {
+        if (auto* parameter = parameters.getParameter(parameterID))
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    };
+    recall(PARAM_DRY_ID, state.dry);
+    recall(PARAM_WET_ID, state.wet);
+    recall(PARAM_DAMP_ID, state.damp);
+    recall(PARAM_ROOM_SIZE_ID, state.room);
+    recall(PARAM_FREEZE_ID, state.freeze ? 1.f : 0.f);
+    
+    detail_profile profile;
+    for (int order = 0; order < plugin_state::detail_orders; order++){
+        profile.combs[order] = state.detail_combs[order];
+        profile.allpasses[order] = state.detail_allpasses[order];
+    }
+    setdetailprofile(profile);
+}
+
+plugin_state::values AudioPluginAudioProcessor::getparameterstate()
+{
+    plugin_state::values state;
+    state.dry = parameters.getRawParameterValue(PARAM_DRY_ID)->load();
+    state.wet = parameters.getRawParameterValue(PARAM_WET_ID)->load();
+    state.room = parameters.getRawParameterValue(PARAM_ROOM_SIZE_ID)->load();
+    state.damp = parameters.getRawParameterValue(PARAM_DAMP_ID)->load();
+    state.freeze = parameters.getRawParameterValue(PARAM_FREEZE_ID)->load() >= 0.5f;
+    for (int order = 0; order < plugin_state::detail_orders; order++){
+        state.detail_combs[order] = (uint8_t) detailCombs[order].load(std::memory_order_relaxed);
+        state.detail_allpasses[order] = (uint8_t) detailAllpasses[order].load(std::memory_order_relaxed);
+    }
+    return state;
 }
 
 void AudioPluginAudioProcessor::parameterChanged(const juce::String &parameterID, float newValue) {
+    REVERB_TRACE_INSTANT("parameterChanged");
     if (parameterID == PARAM_DRY_ID) {
         setdry(newValue);
     } else if (parameterID == PARAM_WET_ID) {
         setwet(newValue);
     } else if (parameterID == PARAM_ROOM_SIZE_ID) {
-        newroom = newValue;
+        model.requestroomsize(newValue);
     } else if (parameterID == PARAM_DAMP_ID) {
         setdamp(newValue);
     } else if (parameterID == PARAM_FREEZE_ID) {
@@ -290,137 +346,421 @@ juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 
 void AudioPluginAudioProcessor::mute()
 {
-    for (int i = 0; i < numOutputChannels-1; i++){
-        for (int j = 0; j < numcombs; j++){
-            comb[i][j].mute();
+    model.mute();
+}
+
+void AudioPluginAudioProcessor::processoffline(juce::AudioBuffer<float>& buffer, juce::ThreadPool& pool)
+{
+    juce::ScopedNoDenormals noDenormals;
+    serveSnapshotRequest();
+    if (model.canapplyqualitytier() && detailChanged.exchange(false, std::memory_order_acquire)) applyQualityTier(qualityTier);
+    const int numSamples = buffer.getNumSamples();
+    
+    model.downmix(buffer.getArrayOfReadPointers(), numSamples);
+    
+    if (not model.canprocesschannels()) {
+        model.process(buffer.getArrayOfWritePointers(), numSamples);
+        finishBlock(buffer.getArrayOfWritePointers(), numSamples);
+        return;
+    }
+    
+    // The channels are independent until they are summed into ACN0, every job runs the comb_filter bank and the
+    // allpass_filter chain of every numJobs-th channel, so that the jobs get the same amount of work.
+    const int numJobs = juce::jmin(pool.getNumThreads(), numOutputChannels-1);
+    std::atomic<int> remainingJobs {numJobs};
+    juce::WaitableEvent finished;
+    for (int job = 0; job < numJobs; job++){
+        pool.addJob([&, job] {
+            juce::ScopedNoDenormals noDenormalsInJob;
+            for(int channel=1+job; channel<numOutputChannels; channel+=numJobs)
+                model.processchannel(channel, buffer.getWritePointer(channel), numSamples);
+            if (--remainingJobs == 0) finished.signal();
+        });
+    }
+    if (numJobs > 0) finished.wait();
+    
+    // summed in channel order, so the output is the same as the one of processBlock
+    model.mixchannels(buffer.getArrayOfWritePointers(), numSamples);
+    
+    finishBlock(buffer.getArrayOfWritePointers(), numSamples);
+}
+
+void AudioPluginAudioProcessor::finishBlock(float* const* outputs, int numSamples)
+{
+    // Denormals are flushed while processing, any that show up here come from the host or a missing FTZ mode.
+    // ACN0 is the sum of all channels, so a NaN or infinity in any of them shows up there. Denormals do not add up like
+    // that, they are counted in one further channel per block in turn, instead of reading all outputs once more.
+    int denormals = 0, nonFinite = 0;
+    {
+        REVERB_TRACE_SCOPE("output check");
+        const diffuse_kernels::kernel_table& kernels = model.getkernels();
+        kernels.count_abnormal(outputs[0], numSamples, denormals, nonFinite);
+        if (numOutputChannels > 1) {
+            kernels.count_abnormal(outputs[abnormalCheckChannel], numSamples, denormals, nonFinite);
+            abnormalCheckChannel = abnormalCheckChannel % (numOutputChannels-1) + 1;
         }
     }
+    if (denormals > 0) denormalSamples.store(denormalSamples.load(std::memory_order_relaxed) + (uint64_t) denormals, std::memory_order_relaxed);
+    if (nonFinite > 0) nonFiniteSamples.store(nonFiniteSamples.load(std::memory_order_relaxed) + (uint64_t) nonFinite, std::memory_order_relaxed);
     
-    for (int i = 0; i < numOutputChannels-1; i++){
-        for (int j = 0; j < numallpasses; j++){
-            allpass[i][j].mute();
+    resizeInProgress.store(model.finishblock(), std::memory_order_relaxed);
+}
+
+void AudioPluginAudioProcessor::applyQualityTier(int tier)
+{
+    int combs[plugin_state::detail_orders];
+    int allpasses[plugin_state::detail_orders];
+    for (int order = 0; order < plugin_state::detail_orders; order++){
+        combs[order] = detailCombs[order].load(std::memory_order_relaxed);
+        allpasses[order] = detailAllpasses[order].load(std::memory_order_relaxed);
+    }
+    model.applyqualitytier(tier, combs, allpasses);
+    qualityTier = tier;
+}
+
+bool AudioPluginAudioProcessor::setsnapshotslots(int numSlots, const juce::File& file)
+{
+    // waits for a running processBlock, the arena is replaced below
+    const bool wasSuspended = isSuspended();
+    suspendProcessing(true);
+    // the snapshot_writer saves the last captures with the current slots
+    freeSnapshots();
+    numSnapshotSlots = juce::jlimit(0, 32, numSlots);
+    snapshotFile = file;
+    const bool mapped = allocateSnapshots();
+    suspendProcessing(wasSuspended);
+    return mapped;
+}
+
+bool AudioPluginAudioProcessor::capturesnapshot(int slot)
+{
+    if (slot < 0 || slot >= numSnapshotSlots) return false;
+    snapshotRequest.store(slot + 1, std::memory_order_release);
+    return true;
+}
+
+bool AudioPluginAudioProcessor::restoresnapshot(int slot)
+{
+    if (slot < 0 || slot >= numSnapshotSlots || (getsnapshots() & (1u << slot)) == 0) return false;
+    int expected = restoreIdle;
+    if (not restoreState.compare_exchange_strong(expected, restoreUnpacking, std::memory_order_acquire)) return false;
+    REVERB_TRACE_SCOPE("unpack snapshot");
+    const bool unpacked = unpackSnapshot(slot);
+    restoreState.store(unpacked ? restoreReady : restoreIdle, std::memory_order_release);
+    return unpacked;
+}
+
+uint32_t AudioPluginAudioProcessor::getsnapshots()
+{
+    return validSnapshots.load(std::memory_order_acquire);
+}
+
+bool AudioPluginAudioProcessor::matchesSnapshot(const snapshot_header& header)
+{
+    return header.magic == snapshotMagic && header.valid == 1 && header.size == snapshotStateSize
+        && header.channels == numOutputChannels && header.sampleRate == snapshotSampleRate
+        && header.storage == snapshotStorage && header.interpolation == snapshotInterpolation;
+}
+
+bool AudioPluginAudioProcessor::allocateSnapshots()
+{
+    freeSnapshots();
+    snapshotRequest.store(0);
+    validSnapshots.store(0);
+    unsavedSnapshots.store(0);
+    for (auto& sequence : snapshotSequence) sequence.store(0);
+    restoreState.store(restoreIdle);
+    restoreCombs.clear();
+    restoreAllpasses.clear();
+    // allocated by prepareToPlay once the filters exist
+    if (numSnapshotSlots == 0 || numOutputChannels == 0) return true;
+    
+    snapshotStateSize = sizeof(snapshot_header);
+    for (int channel = 1; channel < numOutputChannels; channel++){
+        for (int j = 0; j < numcombs; j++) snapshotStateSize += model.getcomb(channel, j).statesize();
+        for (int j = 0; j < numallpasses; j++) snapshotStateSize += model.getallpass(channel, j).statesize();
+    }
+    // the slots start on cache lines
+    snapshotSlotSize = (snapshotStateSize + 63) & ~(size_t) 63;
+    snapshotArenaSize = snapshotSlotSize * (size_t) numSnapshotSlots;
+    
+    // The audio thread captures into this memory, so every page is mapped now. Locking keeps the pages from being
+    // swapped out, where that is not allowed they are at least touched once.
+    snapshotMemory.allocate(snapshotArenaSize, true);
+    snapshotArena = snapshotMemory.get();
+   #if ! JUCE_WINDOWS
+    snapshotMemoryLocked = mlock(snapshotArena, snapshotArenaSize) == 0;
+   #endif
+    if (not snapshotMemoryLocked){
+        volatile unsigned char* pages = snapshotArena;
+        for (size_t offset = 0; offset < snapshotArenaSize; offset += 4096) pages[offset] = 0;
+    }
+    restoreCombs.resize((size_t) (numOutputChannels-1) * numcombs);
+    restoreAllpasses.resize((size_t) (numOutputChannels-1) * numallpasses);
+    
+    bool mapped = false;
+    if (snapshotFile != juce::File()){
+        // a file of another configuration is started over
+        if (snapshotFile.getSize() != (juce::int64) snapshotArenaSize){
+            snapshotFile.deleteFile();
+            juce::FileOutputStream stream(snapshotFile);
+            if (stream.openedOk()) stream.writeRepeatedByte(0, snapshotArenaSize);
         }
+        snapshotMapping = std::make_unique<juce::MemoryMappedFile>(snapshotFile, juce::MemoryMappedFile::readWrite);
+        mapped = snapshotMapping->getData() != nullptr && snapshotMapping->getSize() == snapshotArenaSize;
+        if (not mapped) snapshotMapping.reset();
     }
+    
+    // snapshots an earlier run left in the file
+    uint32_t valid = 0;
+    if (mapped){
+        const auto* file = static_cast<const unsigned char*>(snapshotMapping->getData());
+        for (int slot = 0; slot < numSnapshotSlots; slot++){
+            const size_t offset = (size_t) slot * snapshotSlotSize;
+            if (not matchesSnapshot(*reinterpret_cast<const snapshot_header*>(file + offset))) continue;
+            std::memcpy(snapshotArena + offset, file + offset, snapshotSlotSize);
+            valid |= 1u << slot;
+        }
+        snapshotWriter = std::make_unique<snapshot_writer>(*this);
+        snapshotWriter->startThread();
+    }
+    validSnapshots.store(valid, std::memory_order_release);
+    return mapped || snapshotFile == juce::File();
 }
 
-void AudioPluginAudioProcessor::setroomsize(float value)
+void AudioPluginAudioProcessor::freeSnapshots()
 {
-    feedback = (value*scalefeedback) + offsetfeedback;
-    comb_buffactor = 1 + (value*scale_comb_buffer)-(scale_comb_buffer/2);
-    allpass_buffactor = 1 + (value*scale_allpass_buffer)-(scale_allpass_buffer/2);
+    if (snapshotWriter != nullptr){
+        snapshotWriter->stopThread(2000);
+        snapshotWriter.reset();
+    }
+    snapshotMapping.reset();
+   #if ! JUCE_WINDOWS
+    if (snapshotMemoryLocked) munlock(snapshotArena, snapshotArenaSize);
+   #endif
+    snapshotMemoryLocked = false;
+    snapshotMemory.free();
+    snapshotArena = nullptr;
+}
+
+void AudioPluginAudioProcessor::serveSnapshotRequest()
+{
+    if (restoreState.load(std::memory_order_acquire) == restoreReady){
+        REVERB_TRACE_SCOPE("restore snapshot");
+        // the feedback of the snapshot's room size, the delay lines are swapped in below
+        model.setroomsize(restoreRoom);
+        size_t combIndex = 0;
+        size_t allpassIndex = 0;
+        for (int channel = 1; channel < numOutputChannels; channel++){
+            for (int j = 0; j < numcombs; j++) model.getcomb(channel, j).swapstate(restoreCombs[combIndex++]);
+            for (int j = 0; j < numallpasses; j++) model.getallpass(channel, j).swapstate(restoreAllpasses[allpassIndex++]);
+        }
+        // the restored tail is recorded again
+        model.restartfreeze();
+        restoreState.store(restoreIdle, std::memory_order_release);
+    }
+    
+    const int request = snapshotRequest.exchange(0, std::memory_order_acquire);
+    if (request == 0 || snapshotArena == nullptr) return;
+    REVERB_TRACE_SCOPE("capture snapshot");
     
-    for (int i = 0; i < numOutputChannels-1; i++){
+    const int slot = request - 1;
+    unsigned char* slotStart = snapshotArena + (size_t) slot * snapshotSlotSize;
+    auto* header = reinterpret_cast<snapshot_header*>(slotStart);
+    unsigned char* position = slotStart + sizeof(snapshot_header);
+    
+    // odd until the slot is complete, restoresnapshot and the snapshot_writer retry or skip it meanwhile
+    snapshotSequence[slot].fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->valid = 0;
+    for (int channel = 1; channel < numOutputChannels; channel++){
+        for (int j = 0; j < numcombs; j++){
+            model.getcomb(channel, j).savestate(position);
+            position += model.getcomb(channel, j).statesize();
+        }
+        for (int j = 0; j < numallpasses; j++){
+            model.getallpass(channel, j).savestate(position);
+            position += model.getallpass(channel, j).statesize();
+        }
+    }
+    header->magic = snapshotMagic;
+    header->size = (uint64_t) (position - slotStart);
+    header->room = model.getroomsize();
+    header->channels = numOutputChannels;
+    header->sampleRate = snapshotSampleRate;
+    header->storage = snapshotStorage;
+    header->interpolation = snapshotInterpolation;
+    header->valid = 1;
+    snapshotSequence[slot].fetch_add(1, std::memory_order_release);
+    validSnapshots.fetch_or(1u << slot, std::memory_order_release);
+    unsavedSnapshots.fetch_or(1u << slot, std::memory_order_release);
+}
+
+bool AudioPluginAudioProcessor::unpackSnapshot(int slot)
+{
+    const uint32_t sequence = snapshotSequence[slot].load(std::memory_order_acquire);
+    if (sequence & 1) return false;
+    const unsigned char* slotStart = snapshotArena + (size_t) slot * snapshotSlotSize;
+    const auto* header = reinterpret_cast<const snapshot_header*>(slotStart);
+    if (not matchesSnapshot(*header)) return false;
+    restoreRoom = header->room;
+    const unsigned char* position = slotStart + sizeof(snapshot_header);
+    size_t combIndex = 0;
+    size_t allpassIndex = 0;
+    for (int channel = 1; channel < numOutputChannels; channel++){
         for (int j = 0; j < numcombs; j++){
-            comb_buffer_size[i][j] = ((int) ((i*spreadvalue) + comb_buffer_tuning[j]*comb_buffactor));
-            comb[i][j].setbuffer(comb_buffer_size[i][j]);
-            comb[i][j].setfeedback(feedback);
+            model.getcomb(channel, j).loadstate(position, restoreCombs[combIndex++]);
+            position += model.getcomb(channel, j).statesize();
         }
         for (int j = 0; j < numallpasses; j++){
-            allpass_buffer_size[i][j] = ((int) ((i*spreadvalue) + allpass_buffer_tuning[j]*allpass_buffactor));
-            allpass[i][j].setbuffer(allpass_buffer_size[i][j]);
-            allpass[i][j].setfeedback(feedback);
+            model.getallpass(channel, j).loadstate(position, restoreAllpasses[allpassIndex++]);
+            position += model.getallpass(channel, j).statesize();
         }
     }
-    oldroom = value;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return snapshotSequence[slot].load(std::memory_order_relaxed) == sequence;
+}
+
+void AudioPluginAudioProcessor::persistSnapshots()
+{
+    const uint32_t unsaved = unsavedSnapshots.exchange(0, std::memory_order_acquire);
+    auto* file = static_cast<unsigned char*>(snapshotMapping->getData());
+    for (int slot = 0; slot < numSnapshotSlots; slot++){
+        if ((unsaved & (1u << slot)) == 0) continue;
+        const size_t offset = (size_t) slot * snapshotSlotSize;
+        auto* fileHeader = reinterpret_cast<snapshot_header*>(file + offset);
+        
+        // The header goes last, so that a slot that is cut short by a crash or a new capture is never restored.
+        const uint32_t sequence = snapshotSequence[slot].load(std::memory_order_acquire);
+        snapshot_header header;
+        bool complete = (sequence & 1) == 0;
+        if (complete){
+            fileHeader->valid = 0;
+            std::memcpy(file + offset + sizeof(snapshot_header), snapshotArena + offset + sizeof(snapshot_header), snapshotSlotSize - sizeof(snapshot_header));
+            std::memcpy(&header, snapshotArena + offset, sizeof(snapshot_header));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            complete = snapshotSequence[slot].load(std::memory_order_relaxed) == sequence;
+        }
+        if (complete) std::memcpy(fileHeader, &header, sizeof(snapshot_header));
+        else unsavedSnapshots.fetch_or(1u << slot, std::memory_order_relaxed);
+    }
+}
+
+void AudioPluginAudioProcessor::setroomsize(float value)
+{
+    model.setroomsize(value);
+}
+
+int AudioPluginAudioProcessor::getactivechannels()
+{
+    return numOutputChannels;
+}
+
+bool AudioPluginAudioProcessor::getresizeinprogress()
+{
+    return resizeInProgress.load(std::memory_order_relaxed);
+}
+
+uint64_t AudioPluginAudioProcessor::getdenormalsamples()
+{
+    return denormalSamples.load(std::memory_order_relaxed);
+}
+
+uint64_t AudioPluginAudioProcessor::getnonfinitesamples()
+{
+    return nonFiniteSamples.load(std::memory_order_relaxed);
+}
+
+const char* AudioPluginAudioProcessor::getkernelsname()
+{
+    return model.getkernels().name;
 }
 
 float AudioPluginAudioProcessor::getroomsize()
 {
-    return (feedback-offsetfeedback)/scalefeedback;
+    return model.getroomsize();
 }
 
 void AudioPluginAudioProcessor::setdamp(float value)
 {
-    if (value < 0.95f && value > 0.05f) {
-        damp = value;
-        for (int i = 0; i < numOutputChannels-1; i++){
-            for (int j = 0; j < numcombs; j++){
-                comb[i][j].setdamp(damp);
-            }
-        }
-    }
+    model.setdamp(value);
 }
 
 float AudioPluginAudioProcessor::getdamp()
 {
-    return damp;
+    return model.getdamp();
 }
 
 void AudioPluginAudioProcessor::setwet(float value)
 {
-    wet_factor = value/numcombs;
+    model.setwet(value);
 }
 
 float AudioPluginAudioProcessor::getwet()
 {
-    return wet_factor*numcombs;
+    return model.getwet();
 }
 
 void AudioPluginAudioProcessor::setdry(float value)
 {
-    dry = value;
+    model.setdry(value);
 }
 
 float AudioPluginAudioProcessor::getdry()
 {
-    return dry;
+    return model.getdry();
 }
 
-void AudioPluginAudioProcessor::setfreezemode(bool state){
-    freezemode = state;
+void AudioPluginAudioProcessor::setfreezemode(bool state)
+{
+    model.setfreezemode(state);
+}
 
-    // Recalculate internal values after parameter change
-    if (freezemode){
-        feedback_filters = 1;
-        damp_comb = 0;
-        gain = 0;
-    }
-    else {
-        feedback_filters = feedback;
-        damp_comb = damp;
-        gain = initialgain;
-        mute();
+bool AudioPluginAudioProcessor::getfreezemode()
+{
+    return model.getfreezemode();
+}
+
+block_load_monitor& AudioPluginAudioProcessor::getloadmonitor()
+{
+    return loadMonitor;
+}
+
+void AudioPluginAudioProcessor::setdetailprofile(const detail_profile& profile)
+{
+    for (int order = 0; order < plugin_state::detail_orders; order++){
+        detailCombs[order].store(juce::jlimit(1, numcombs, profile.combs[order]), std::memory_order_relaxed);
+        detailAllpasses[order].store(juce::jlimit(0, numallpasses, profile.allpasses[order]), std::memory_order_relaxed);
     }
+    detailChanged.store(true, std::memory_order_release);
+}
 
-    for (int i = 0; i < numOutputChannels-1; i++){
-        for (int j = 0; j < numcombs; j++){
-            comb[i][j].setfeedback(feedback_filters);
-            comb[i][j].setdamp(damp_comb);
-        }
-        for (int j = 0; j < numallpasses; j++){
-            allpass[i][j].setfeedback(feedback_filters);
-        }
+AudioPluginAudioProcessor::detail_profile AudioPluginAudioProcessor::getdetailprofile()
+{
+    detail_profile profile;
+    for (int order = 0; order < plugin_state::detail_orders; order++){
+        profile.combs[order] = detailCombs[order].load(std::memory_order_relaxed);
+        profile.allpasses[order] = detailAllpasses[order].load(std::memory_order_relaxed);
     }
+    return profile;
 }
 
-bool AudioPluginAudioProcessor::getfreezemode()
+void AudioPluginAudioProcessor::setqualitygovernor(const quality_governor::settings& settings)
 {
-    return freezemode;
+    governor.set_settings(settings);
 }
 
-void AudioPluginAudioProcessor::SN3D_normalization(int channelnum){
-    for (int i = 0; i < numOutputChannels; i++){
-        if(i <= 3 || i == 6 || i == 12){
-            ACN_normalization[i] = 1.f;
-        }
-        if(i == 4 || i == 8){
-            ACN_normalization[i] = std::sqrtf(2/(4*24*M_PI))/std::sqrtf(1/(4*M_PI));
-        }
-        if(i == 5 || i == 7){
-            ACN_normalization[i] = std::sqrtf(2/(4*6*M_PI))/std::sqrtf(1/(4*M_PI));
-        }
-        if(i == 9 || i == 15){
-            ACN_normalization[i] = std::sqrtf(2/(4*720*M_PI))/std::sqrtf(1/(4*M_PI));
-        }
-        if(i == 10 || i == 14){
-            ACN_normalization[i] = std::sqrtf(2/(4*120*M_PI))/std::sqrtf(1/(4*M_PI));
-        }
-        if(i == 11 || i == 13){
-            ACN_normalization[i] = std::sqrtf(2/(4*12*M_PI))/std::sqrtf(1/(4*M_PI));
-        }
-        std::cout << "ACN " << i << " norm factor: " << ACN_normalization[i] << std::endl;
-        
-        sum_ACN_normalization += ACN_normalization[i];
-    }
-    std::cout << "normalization according to SN3D/ambiX standard (sum = " << sum_ACN_normalization << ")" << std::endl;
+quality_governor::settings AudioPluginAudioProcessor::getqualitygovernor()
+{
+    return governor.get_settings();
+}
+
+int AudioPluginAudioProcessor::getqualitytier()
+{
+    return governor.get_tier();
+}
+
+perf_counters& AudioPluginAudioProcessor::getperfcounters()
+{
+    return perfCounters;
 }
@@ -13,6 +13,13 @@
 #include <stdint.h>
 #include "comb_filter.h"
 #include "allpass_filter.h"
+#include "diffuse_kernels.h"
+#include "diffuse_model.h"
+#include "block_load_monitor.h"
+#include "perf_counters.h"
+#include "plugin_state.h"
+#include "quality_governor.h"
+#include "trace.h"
 #include "tuning.h"
 
 #define PARAM_DRY_ID "param_dry"
@@ -37,6 +44,9 @@ public:
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    /// \brief AudioPluginAudioProcessor::reset Clears the diffuse model without reallocating it, the next block sounds like the first one after prepareToPlay
+    /// \details A pending room size is taken over at once instead of resizing the delay lines. Must not be called while processBlock runs.
+    void reset() override;
 
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
 
@@ -111,6 +121,7 @@ public:
     float    getdry();
         
     /// \brief AudioPluginAudioProcessor::setfreezemode Sets the freeze option on and off
+    /// \details The diffuse model recirculates without input until it has recorded freeze_loop_length plus freeze_crossfade_length seconds of every channel, then the tail is played from the loop and the comb_filter and allpass_filter instances are idle until the freeze ends.
     /// \param value The desired state value [bool]
     void    setfreezemode(bool value);
         
@@ -118,38 +129,191 @@ public:
     /// \return The freezemode state value [bool]
     bool    getfreezemode();
     
-    /// \brief AudioPluginAudioProcessor::SN3D_normalization Calculates the normalization factors for the ambisonics channels based on the SN3D/ambiX standard
-    /// \param channelnum The channelnumber set in the tuning.h file
-    void SN3D_normalization(int channelnum);
+    /// \brief AudioPluginAudioProcessor::getloadmonitor Gets the processing time statistics of processBlock
+    /// \details The statistics can be read and reset from any thread without disturbing the audio thread.
+    /// \return the block_load_monitor of this instance
+    block_load_monitor& getloadmonitor();
+    
+    /// \brief AudioPluginAudioProcessor::getperfcounters Gets the hardware performance counters of the processing stages
+    /// \details The counters only count in builds with REVERB_PERF_COUNTERS, see perf_counters.h.
+    /// \return the perf_counters of this instance
+    perf_counters& getperfcounters();
+    
+    /// \brief AudioPluginAudioProcessor::processdirect Processes a block like processBlock, straight from and into the channel buffers of an audio device
+    /// \details processBlock calls this with the channels of its buffer. The standalone app calls it with the buffers of the device, so that no AudioBuffer has to be set up and nothing is copied. The outputs may alias the inputs, the inputs are mixed down before any output is written. Real-time safe, the caller holds the callback lock like a host would.
+    /// \param inputs the getTotalNumInputChannels input channels
+    /// \param outputs the getTotalNumOutputChannels output channels
+    /// \param numSamples the number of samples, at most the block size given to prepareToPlay
+    void    processdirect(const float* const* inputs, float* const* outputs, int numSamples);
+    
+    /// \brief AudioPluginAudioProcessor::processoffline Processes a block like processBlock with the channels distributed over a thread pool, for offline rendering
+    /// \details The output is the same as the one of processBlock. The call blocks until all jobs finished, it allocates and must not be used on the audio thread.
+    /// \param buffer the input and output buffer, as for processBlock
+    /// \param pool the threads that process the channels
+    void    processoffline(juce::AudioBuffer<float>& buffer, juce::ThreadPool& pool);
+    
+    /// \brief AudioPluginAudioProcessor::getactivechannels Gets the number of output channels set up by prepareToPlay
+    /// \return the number of output channels [int]
+    int     getactivechannels();
+    
+    /// \brief AudioPluginAudioProcessor::getresizeinprogress Checks whether the delay lines are still running towards the last room size
+    /// \return true while a resize is in progress [bool]
+    bool    getresizeinprogress();
+    
+    /// \brief AudioPluginAudioProcessor::getdenormalsamples Gets the number of denormal output samples since prepareToPlay
+    /// \details Counted in ACN0 and in one further channel per block in turn, so the number is a sample of all outputs.
+    /// \return the number of denormal samples [uint64_t]
+    uint64_t getdenormalsamples();
+    
+    /// \brief AudioPluginAudioProcessor::getnonfinitesamples Gets the number of NaN and infinite output samples since prepareToPlay
+    /// \details Counted in ACN0, which gets the NaN and infinite samples of all channels, and in one further channel per block in turn.
+    /// \return the number of not finite samples [uint64_t]
+    uint64_t getnonfinitesamples();
+    
+    /// \brief Number of comb_filter and allpass_filter instances per channel, by ambisonic order 1 to 7
+    struct detail_profile{
+        int combs[plugin_state::detail_orders];
+        int allpasses[plugin_state::detail_orders];
+    };
+    
+    /// \brief AudioPluginAudioProcessor::setdetailprofile Sets how many filters the channels of every order run, may be called from any thread
+    /// \details The profile is taken over at the start of the next block and saved with the state. The comb_filter count is at least 1 and the quality_governor may lower it further, the wet gain of a channel is raised by the square root of the dropped fraction of its combs, so that the level of the tail stays the same. The allpass_filter count may be 0.
+    /// \param profile the filter counts, see detail_profile_combs and reduced_detail_combs in tuning.h
+    void    setdetailprofile(const detail_profile& profile);
+    
+    /// \brief AudioPluginAudioProcessor::getdetailprofile Gets the filter counts per order
+    /// \return the profile [detail_profile]
+    detail_profile getdetailprofile();
+    
+    /// \brief AudioPluginAudioProcessor::setqualitygovernor Configures the quality_governor of this instance, may be called from any thread
+    /// \details The governor is off in a plugin host, where the quality should not change behind the user's back, and on in the standalone app. In non-realtime processing the governor is not consulted and the quality stays where it is.
+    /// \param settings the thresholds and the lowest quality tier, see quality_governor.h
+    void    setqualitygovernor(const quality_governor::settings& settings);
+    
+    /// \brief AudioPluginAudioProcessor::getqualitygovernor Gets the configuration of the quality_governor
+    /// \return the settings [quality_governor::settings]
+    quality_governor::settings getqualitygovernor();
+    
+    /// \brief AudioPluginAudioProcessor::getqualitytier Gets the quality tier the diffuse model runs with, 0 is the full model
+    /// \return the tier, see quality_tier_combs in tuning.h [int]
+    int     getqualitytier();
+    
+    /// \brief AudioPluginAudioProcessor::setsnapshotslots Sets up slots for snapshots of the complete diffuse model
+    /// \details A snapshot holds every delay line, write position and filter state and the room size. All slots share one arena in memory that is allocated here, or by prepareToPlay if the filters are not prepared yet, and locked or touched page by page, so a capture never allocates or faults a page in. Not real-time safe, processing is suspended while the arena is replaced. Must not run at the same time as restoresnapshot.
+    /// \param numSlots the number of snapshots, at most 32, 0 frees the arena
+    /// \param file if not empty, a background thread copies every capture into a memory mapping of this file, so the snapshots survive the process and are found again by the next run with the same configuration and sample rate
+    /// \return false if the file could not be mapped, the snapshots are then only kept in memory
+    bool    setsnapshotslots(int numSlots, const juce::File& file);
+    
+    /// \brief AudioPluginAudioProcessor::capturesnapshot Captures the diffuse model into a slot at the start of the next block, may be called from any thread
+    /// \return false if the slot does not exist
+    bool    capturesnapshot(int slot);
+    
+    /// \brief AudioPluginAudioProcessor::restoresnapshot Restores a slot at the start of the next block, not real-time safe
+    /// \details The slot is unpacked into spare delay lines on the calling thread, the audio thread only swaps them with its own. The delay lines continue exactly where they were captured, with the room size of the snapshot, and then glide to the room size parameter if it differs. The feedback and dampening follow the current parameters and the freeze mode.
+    /// \return false if the slot holds no snapshot, the previous restore is not taken over yet or the slot was captured again while it was unpacked
+    bool    restoresnapshot(int slot);
+    
+    /// \brief AudioPluginAudioProcessor::getsnapshots Gets the slots that hold a snapshot
+    /// \return bit i is set if slot i can be restored [uint32_t]
+    uint32_t getsnapshots();
+    
+    /// \brief AudioPluginAudioProcessor::getparameterstate Gets the current parameter values as they are saved by getStateInformation
+    /// \return the parameter values and the detail profile [plugin_state::values]
+    plugin_state::values getparameterstate();
+    
+    /// \brief AudioPluginAudioProcessor::getkernelsname Gets the instruction set of the diffuse model kernels
+    /// \return the name of the instruction set [const char*]
+    const char* getkernelsname();
     
 private:
-    juce::AudioBuffer<float> inputBuffer;
-
-    comb_filter **comb;
-    allpass_filter **allpass;
-    
-    float    max_comb_buffactor;
-    float    max_allpass_buffactor;
-    int      **comb_buffer_size;
-    int      **allpass_buffer_size;
-    float    gain;
-    float    feedback;
-    float    comb_buffactor;
-    float    allpass_buffactor;
-    float    damp;
-    float    wet_factor;
-    float    order_factor;
-    float    dry;
-    float    width;
-    bool     freezemode;
-    float    damp_comb;
-    float    feedback_filters;
-    float    newroom;
-    float    oldroom;
-    int      numInputChannels;
-    int      numOutputChannels;
-    float    *ACN_normalization;
-    float    sum_ACN_normalization;
+    /// the comb_filter and allpass_filter network with its parameters, the freeze loop and the quality tier fades
+    diffuse_model model;
+    
+    /// \brief AudioPluginAudioProcessor::finishBlock Counts the abnormal output samples and lets the diffuse_model take over a new room size once the delay lines are ready
+    /// \param outputs the output channels
+    /// \param numSamples the number of samples
+    void finishBlock(float* const* outputs, int numSamples);
+    /// \brief AudioPluginAudioProcessor::applyQualityTier Passes the detail profile and a quality tier to diffuse_model::applyqualitytier, called by the audio thread
+    void applyQualityTier(int tier);
+    /// \brief AudioPluginAudioProcessor::allocateSnapshots Allocates the snapshot arena for the prepared filters and loads the snapshots of the snapshot file
+    /// \return false if the snapshot file could not be mapped
+    bool allocateSnapshots();
+    /// \brief AudioPluginAudioProcessor::freeSnapshots Stops the snapshot_writer once it saved the last captures and frees the snapshot arena
+    void freeSnapshots();
+    /// \brief AudioPluginAudioProcessor::serveSnapshotRequest Captures a snapshot requested since the last block or swaps in an unpacked one, called at the start of every block
+    void serveSnapshotRequest();
+    /// \brief AudioPluginAudioProcessor::unpackSnapshot Unpacks a slot into the restore states, called by restoresnapshot
+    /// \return false if the slot does not fit the prepared filters or was captured again meanwhile
+    bool unpackSnapshot(int slot);
+    /// \brief AudioPluginAudioProcessor::persistSnapshots Copies the slots captured since the last call into the snapshot file, called by the snapshot_writer
+    void persistSnapshots();
+    /// "RVS2", the first word of a snapshot slot
+    static constexpr uint32_t snapshotMagic = 0x32535652;
+    /// \brief Start of every snapshot slot, followed by the states of the comb_filter and allpass_filter instances channel by channel
+    struct snapshot_header{
+        uint32_t magic;
+        uint32_t valid;
+        uint64_t size;
+        float    room;
+        int32_t  channels;
+        double   sampleRate;
+        /// the delay_storage and delay_interpolation the states were saved with
+        uint32_t storage;
+        uint32_t interpolation;
+    };
+    /// \brief AudioPluginAudioProcessor::matchesSnapshot Checks whether a slot holds a snapshot of the prepared filters
+    bool matchesSnapshot(const snapshot_header& header);
+    /// background thread that copies the captures into the snapshot file
+    class snapshot_writer;
+    int numSnapshotSlots = 0;
+    juce::File snapshotFile;
+    /// the slots, only written by the audio thread
+    juce::HeapBlock<unsigned char> snapshotMemory;
+    bool snapshotMemoryLocked = false;
+    /// the snapshot file, only touched by allocateSnapshots and the snapshot_writer
+    std::unique_ptr<juce::MemoryMappedFile> snapshotMapping;
+    std::unique_ptr<snapshot_writer> snapshotWriter;
+    unsigned char* snapshotArena = nullptr;
+    size_t snapshotArenaSize = 0;
+    size_t snapshotSlotSize = 0;
+    size_t snapshotStateSize = 0;
+    double snapshotSampleRate = 0.0;
+    /// slot + 1 to capture, 0 if nothing is requested
+    std::atomic<int> snapshotRequest {0};
+    std::atomic<uint32_t> validSnapshots {0};
+    /// slots captured since the snapshot_writer copied them into the file
+    std::atomic<uint32_t> unsavedSnapshots {0};
+    /// odd while the audio thread captures into a slot, readers copy a slot between two equal even values
+    std::atomic<uint32_t> snapshotSequence[32] {};
+    /// states unpacked by restoresnapshot, in the order of the slots
+    std::vector<comb_filter::prepared_state> restoreCombs;
+    std::vector<allpass_filter::prepared_state> restoreAllpasses;
+    float restoreRoom = 0.f;
+    enum restore_state { restoreIdle, restoreUnpacking, restoreReady };
+    /// restoresnapshot unpacks while restoreUnpacking, the audio thread swaps the states in once restoreReady
+    std::atomic<int> restoreState {restoreIdle};
+    /// processing time of every block relative to its deadline
+    block_load_monitor loadMonitor;
+    /// hardware counters of the processing stages, only used in instrumentation builds
+    perf_counters perfCounters;
+    /// lowers the quality of the diffuse model when the blocks get close to their deadline
+    quality_governor governor;
+    /// tier applied by applyQualityTier
+    int qualityTier = 0;
+    /// detail profile set by setdetailprofile, taken over by the next block
+    std::atomic<int> detailCombs[plugin_state::detail_orders];
+    std::atomic<int> detailAllpasses[plugin_state::detail_orders];
+    std::atomic<bool> detailChanged {false};
+    /// counters read by the telemetry, written by the audio thread only
+    std::atomic<bool> resizeInProgress {false};
+    std::atomic<uint64_t> denormalSamples {0};
+    std::atomic<uint64_t> nonFiniteSamples {0};
+    /// channel finishBlock counts the abnormal samples of besides ACN0, written by the audio thread only
+    int abnormalCheckChannel = 1;
+
+    int      numInputChannels = 0;
+    int      numOutputChannels = 0;
 
     std::array<std::string, 5> parameterIDs = {PARAM_DRY_ID, PARAM_WET_ID, PARAM_ROOM_SIZE_ID, PARAM_DAMP_ID, PARAM_FREEZE_ID};
 
@@ -9,137 +9,122 @@
 
 #include "allpass_filter.h"
 
-allpass_filter::allpass_filter(){
-    bufidx_read = 0.f;
+#include <cstring>
+
+template <typename Storage, typename Interpolation>
+basic_allpass_filter<Storage, Interpolation>::basic_allpass_filter(){
     bufidx_write = 0;
-    buffer_step = 1.f;
-    decreaser = -1.f;
-    increaser = 0.f;
-    write_done = false;
-    read_done = false;
-    step_diff = 0.f;
+    mask = 0;
+    delay = 0.f;
+    bufsize = 0.f;
+    dither_state = 22222u;
 }
 
-float allpass_filter::process(float input){
-    float output;
-    float bufout;
+template <typename Storage, typename Interpolation>
+void basic_allpass_filter<Storage, Interpolation>::initBuffer(int bufsizeIn){
+    // room for the older interpolation points behind the longest delay
+    unsigned long capacity = 1;
+    while (capacity < (unsigned long) bufsizeIn + Interpolation::older_taps + 1) capacity <<= 1;
     
-    if (bufsize > oldbufsize){
-        step_diff = bufsize - oldbufsize;
+    buffer.assign(capacity, 0);
+    mask = capacity - 1;
+    bufidx_write = 0;
+    delay = 0.f;
+}
 
-        if ((int) (step_diff - decreaser * 0.5f) > 0.1f){
-            decreaser += 1;
-            buffer_step = 0.5f;
-        }
-        else{
-            buffer_step = 1.f;
-            if (write_done){
-                decreaser = -1.f;
-                bufidx_read = (float) bufidx_write;
-                write_done = false;
-                read_done = false;
-                read_new_bufsize = false;
-                step_diff = 0.f;
-                oldbufsize = bufsize;
-            }
-        }
-        if (bufidx_write >= bufsize - 1){
-            write_done = true;
-            read_new_bufsize = true;
-        }
-//        std::cout << "AP 1: " << "bufidx_read: " << bufidx_read << ", bufidx_write: " << bufidx_write << ", oldbufsize: " << oldbufsize << ", bufsize: " << bufsize << ", difference " << step_diff - decreaser * 0.5f << std::endl;
+template <typename Storage, typename Interpolation>
+void basic_allpass_filter<Storage, Interpolation>::setbuffer(int bufsizeIn){
+    // without a delay line from initBuffer there is no range to clamp to
+    if (mask == 0)
+        return;
+    // the newer interpolation points must already be written, a delay line too short for the interpolation keeps the shortest delay
+    const int shortest = Interpolation::newer_taps + 1;
+    bufsize = (float) std::clamp(bufsizeIn, shortest, std::max(shortest, (int) mask - Interpolation::older_taps));
+    // the first buffersize after initBuffer is taken over without resizing
+    if (delay == 0.f){
+        delay = bufsize;
     }
+}
 
-    else if (bufsize < oldbufsize){
-        if (step_diff == 0){
-            if (bufidx_write > bufsize){
-                bufsize_written = bufidx_write;
-            }
-            else bufsize_written = bufsize;
-        }
-        step_diff = oldbufsize - bufsize_written;
-        if ((int) (step_diff - increaser) >= 0.1f){
-            increaser += 1;
-            buffer_step = 2.f;
-        }
-        else{
-            buffer_step = 1.f;
-            if (read_done){
-                increaser = 0.f;
-                bufidx_read = (float) bufidx_write;
-                read_done = false;
-                write_done = false;
-                step_diff = 0.f;
-                read_new_bufsize = false;
-                oldbufsize = bufsize;
-            }
-        }
-        if ((int) bufidx_read >= oldbufsize - 2) {
-            read_done = true;
-            read_new_bufsize = true;
-        }
-//        std::cout << "AP 2: " << "bufidx_read: " << bufidx_read << ", bufidx_write: " << bufidx_write << ", oldbufsize: " << oldbufsize << ", bufsize: " << bufsize << ", difference " << step_diff - increaser << ", read_done: " << read_done << std::endl;
+template <typename Storage, typename Interpolation>
+void basic_allpass_filter<Storage, Interpolation>::mute(){
+    for (auto & sample : buffer){
+        sample = 0;
     }
-    
-    // whats actually done
-    bufout = input - feedback * read_buffer(bufidx_read, buffer_step);
-    output = feedback * bufout + read_buffer(bufidx_read, buffer_step);
-    
-    buffer[bufidx_write] = bufout;
-    
-    bufidx_read = bufidx_read + buffer_step;
-    bufidx_write = bufidx_write + 1;
-    
-    if (not read_new_bufsize) {if(bufidx_read >= (float) oldbufsize) bufidx_read = 0;}
-    else {if(bufidx_read >= (float) bufsize) bufidx_read = 0;}
-    if(bufidx_write>=bufsize) bufidx_write = 0;
-    
-    return output;
 }
 
-float allpass_filter::read_buffer(float idx, float buffer_step){
-    float alpha = idx - (int) idx;
-    int idx_2 = (int) idx + 1;
-    if (idx_2 >= (float) oldbufsize && not read_new_bufsize) idx_2 = 0;
-    if (read_new_bufsize && idx_2 >= (float) bufsize) idx_2 = 0;
-    if (buffer_step <= 1.f) return (1-alpha) * buffer[(int) idx] + alpha * buffer[idx_2];
-    else return 0.5f * (buffer[(int) idx] + buffer[idx_2]);
+template <typename Storage, typename Interpolation>
+void basic_allpass_filter<Storage, Interpolation>::reset(){
+    std::fill(buffer.begin(), buffer.end(), 0);
+    bufidx_write = 0;
+    delay = bufsize;
+    dither_state = 22222u;
+    interpolator = Interpolation();
 }
 
+template <typename Storage, typename Interpolation>
+void basic_allpass_filter<Storage, Interpolation>::setfeedback(float value){
+    feedback = value;
+}
 
-void allpass_filter::initBuffer(int bufsizeIn){
-    buffer.clear();
-    for (int i = 0; i <= bufsizeIn; i++) {
-        buffer.push_back(0.0f);
-    }
-    oldbufsize = bufsizeIn;
+template <typename Storage, typename Interpolation>
+float basic_allpass_filter<Storage, Interpolation>::getfeedback(){
+    return  feedback;
 }
 
-void allpass_filter::setbuffer(int bufsizeIn){
-    bufsize = bufsizeIn;
+template <typename Storage, typename Interpolation>
+bool basic_allpass_filter<Storage, Interpolation>::ready(){
+    return delay == bufsize;
 }
 
-void allpass_filter::mute(){
-    for (float & sample : buffer){
-        sample = 0;
-    }
+template <typename Storage, typename Interpolation>
+size_t basic_allpass_filter<Storage, Interpolation>::statesize() const{
+    return sizeof(scalar_state) + buffer.size() * sizeof(typename Storage::sample_type);
 }
 
-void allpass_filter::setfeedback(float value){
-    feedback = value;
+template <typename Storage, typename Interpolation>
+void basic_allpass_filter<Storage, Interpolation>::savestate(unsigned char* destination) const{
+    scalar_state scalars;
+    scalars.bufidx_write = bufidx_write;
+    scalars.delay = delay;
+    scalars.bufsize = bufsize;
+    scalars.dither_state = dither_state;
+    scalars.interpolator = interpolator;
+    std::memcpy(destination, &scalars, sizeof(scalars));
+    std::memcpy(destination + sizeof(scalars), buffer.data(), buffer.size() * sizeof(typename Storage::sample_type));
 }
 
-float allpass_filter::getfeedback(){
-    return  feedback;
+template <typename Storage, typename Interpolation>
+void basic_allpass_filter<Storage, Interpolation>::loadstate(const unsigned char* source, prepared_state& state) const{
+    state.buffer.resize(buffer.size());
+    std::memcpy(&state.scalars, source, sizeof(state.scalars));
+    std::memcpy(state.buffer.data(), source + sizeof(state.scalars), buffer.size() * sizeof(typename Storage::sample_type));
 }
 
-bool allpass_filter::ready(){
-    if (step_diff == 0.f){
-//        std::cout << "true" << std::endl;
-        return true;
-    }
-    else{
-//        std::cout << "Stepdiff = " << step_diff << std::endl;
-        return false;
-    }
+template <typename Storage, typename Interpolation>
+void basic_allpass_filter<Storage, Interpolation>::swapstate(prepared_state& state){
+    if (state.buffer.size() != buffer.size())
+        return;
+    buffer.swap(state.buffer);
+    bufidx_write = state.scalars.bufidx_write & mask;
+    delay = state.scalars.delay;
+    bufsize = state.scalars.bufsize;
+    dither_state = state.scalars.dither_state;
+    interpolator = state.scalars.interpolator;
 }
+
+template class basic_allpass_filter<float_storage, none_interpolation>;
+template class basic_allpass_filter<float_storage, linear_interpolation>;
+template class basic_allpass_filter<float_storage, hermite_interpolation>;
+template class basic_allpass_filter<float_storage, thiran_interpolation>;
+template class basic_allpass_filter<float_storage, sinc_interpolation>;
+template class basic_allpass_filter<half_storage, none_interpolation>;
+template class basic_allpass_filter<half_storage, linear_interpolation>;
+template class basic_allpass_filter<half_storage, hermite_interpolation>;
+template class basic_allpass_filter<half_storage, thiran_interpolation>;
+template class basic_allpass_filter<half_storage, sinc_interpolation>;
+template class basic_allpass_filter<int16_storage, none_interpolation>;
+template class basic_allpass_filter<int16_storage, linear_interpolation>;
+template class basic_allpass_filter<int16_storage, hermite_interpolation>;
+template class basic_allpass_filter<int16_storage, thiran_interpolation>;
+template class basic_allpass_filter<int16_storage, sinc_interpolation>;
@@ -3,10 +3,12 @@
  *
  * \brief Header for allpass_filter class
  *
- * \class allpass_filter
+ * \class basic_allpass_filter
  *
  * \brief Class defining a Schroeder allpass section.
  *
+ * \details The sample format of the delay line is given by the Storage template parameter (see delay_storage.h), the interpolation while resizing by the Interpolation template parameter (see interpolation.h). allpass_filter is the instance used by the plugin.
+ *
  * \author Fares Schulz
  *
  * \date 2022/10/14
@@ -16,27 +18,35 @@
 #ifndef allpass_filter_h
 #define allpass_filter_h
 
-#include <iostream>
 #include <vector>
+#include <algorithm>
+#include "delay_storage.h"
+#include "interpolation.h"
 
-class allpass_filter{
+template <typename Storage, typename Interpolation = linear_interpolation>
+class basic_allpass_filter{
     
 public:
     /// \brief allpass_filter::allpass_filter The constructor
-    allpass_filter();
+    basic_allpass_filter();
     
     /// \brief allpass_filter::setbuffer Sets the buffersize
+    /// \details The buffersize is the logical delay length, the delay line moves towards it over the following samples (see allpass_filter::ready). Ignored before allpass_filter::initBuffer.
     /// \param bufsizeIn the desired bufsize
     void setbuffer(int bufsizeIn);
     
     /// \brief allpass_filter::process The actual processing method
     /// \param input single sample input [float]
     /// \return the processed output [float]
-    float process(float input);
+    inline float process(float input);
     
     /// \brief allpass_filter::mute Mutes the buffer
     void mute();
     
+    /// \brief allpass_filter::reset Clears the buffer and the filter state and takes over the buffersize set by allpass_filter::setbuffer without resizing
+    /// \details After reset the filter processes like a filter that was just initialized with this buffersize, the buffer is not reallocated.
+    void reset();
+    
     /// \brief allpass_filter::setfeedback Sets the feedback faktor
     /// \param val the desired feedback value
     void setfeedback(float val);
@@ -46,27 +56,111 @@ public:
     float getfeedback();
     
     /// \brief allpass_filter::initBuffer Initializes the buffer
-    /// \details First the the buffer vector gets cleared and then the longest possible buffersize is written with zeros.
-    /// \param bufsizeIn the initial buffersize
+    /// \details The buffer is allocated with zeros at the next power of two that holds the longest possible buffersize, so that the read and write positions can be wrapped with a bitmask.
+    /// \param bufsizeIn the longest possible buffersize
     void initBuffer(int bufsizeIn);
+    
+    /// \brief allpass_filter::ready Checks whether the delay line has reached the buffersize set by allpass_filter::setbuffer
+    /// \return true if no resize is in progress
     bool ready();
     
+    /// \brief allpass_filter::statesize Gets the number of bytes allpass_filter::savestate writes, the delay line and the filter state
+    size_t statesize() const;
+    
+    /// \brief allpass_filter::savestate Copies the delay line and the filter state, the feedback belong to the parameters and are not saved
+    /// \param destination at least allpass_filter::statesize bytes
+    void savestate(unsigned char* destination) const;
+    
+    struct prepared_state;
+    
+    /// \brief allpass_filter::loadstate Unpacks a state saved by a filter with the same longest buffersize, for allpass_filter::swapstate
+    /// \details Allocates the delay line of state on its first use and copies the whole delay line, call it outside the audio thread.
+    /// \param source the bytes written by allpass_filter::savestate
+    /// \param state receives the delay line and the filter state
+    void loadstate(const unsigned char* source, prepared_state& state) const;
+    
+    /// \brief allpass_filter::swapstate Restores a state unpacked by allpass_filter::loadstate without copying the delay line
+    /// \details The delay lines are swapped, afterwards state holds the previous delay line of the filter.
+    /// \param state unpacked by allpass_filter::loadstate of this filter
+    void swapstate(prepared_state& state);
+    
 private:
     float feedback;
-    std::vector<float> buffer;
-    unsigned long bufsize;
-    unsigned long bufsize_written;
-    unsigned long oldbufsize = 0;
-    float bufidx_read;
+    std::vector<typename Storage::sample_type> buffer;
+    uint32_t dither_state;
+    /// bitmask that wraps positions in the power-of-two buffer
+    unsigned long mask;
     unsigned long bufidx_write;
-    float read_buffer(float value, float buffer_step);
-    float buffer_step;
-    float decreaser;
-    float increaser;
-    bool write_done;
-    bool read_done;
-    bool read_new_bufsize = false;
-    float step_diff;
+    /// current delay length in samples, fractional while the delay line is resized
+    float delay;
+    /// delay length set by allpass_filter::setbuffer
+    float bufsize;
+    /// \brief allpass_filter::read_buffer Reads the sample that was written delay samples ago
+    /// \param delay the delay in samples
+    /// \param buffer_step read speed relative to the write speed (0.5 while growing, 2 while shrinking and 1 otherwise)
+    inline float read_buffer(float delay, float buffer_step);
+    /// fractional delay interpolation used while resizing
+    Interpolation interpolator;
+    /// \brief Everything but the delay line that allpass_filter::savestate copies
+    struct scalar_state{
+        unsigned long bufidx_write;
+        float delay;
+        float bufsize;
+        uint32_t dither_state;
+        Interpolation interpolator;
+    };
+    
+public:
+    /// \brief A state unpacked by allpass_filter::loadstate, taken over by allpass_filter::swapstate
+    struct prepared_state{
+        std::vector<typename Storage::sample_type> buffer;
+        scalar_state scalars;
+    };
 };
 
+template <typename Storage, typename Interpolation>
+float basic_allpass_filter<Storage, Interpolation>::process(float input){
+    float output;
+    float bufout;
+    float delayed;
+    
+    // While resizing, the read position moves with half speed (growing) or double speed (shrinking) until the new delay is reached.
+    if (delay == bufsize){
+        delayed = read_buffer(delay, 1.f);
+    }
+    else if (delay < bufsize){
+        delayed = read_buffer(delay, 0.5f);
+        delay = std::min(delay + 0.5f, bufsize);
+    }
+    else{
+        delayed = read_buffer(delay, 2.f);
+        delay = std::max(delay - 1.f, bufsize);
+    }
+    
+    // whats actually done
+    bufout = input - feedback * delayed;
+    output = feedback * bufout + delayed;
+    
+    buffer[bufidx_write] = Storage::encode(bufout, dither_state);
+    
+    bufidx_write = (bufidx_write + 1) & mask;
+    
+    return output;
+}
+
+template <typename Storage, typename Interpolation>
+float basic_allpass_filter<Storage, Interpolation>::read_buffer(float delay, float buffer_step){
+    const unsigned long idx = (unsigned long) delay;
+    const unsigned long position = (bufidx_write - idx) & mask;
+    if (buffer_step == 1.f){
+        const float sample = Storage::decode(buffer[position]);
+        interpolator.track(sample);
+        return sample;
+    }
+    return interpolator.template read<Storage>(buffer.data(), mask, position, delay - (float) idx, buffer_step);
+}
+
+/// the allpass_filter used by the plugin, stores its delay line in the format selected by REVERB_DELAY_STORAGE and interpolates as selected by REVERB_DELAY_INTERPOLATION
+using allpass_filter = basic_allpass_filter<delay_storage, delay_interpolation>;
+
 #endif /* allpass_filter_h */
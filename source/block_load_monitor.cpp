@@ -0,0 +1,95 @@
+/**
+ * \file block_load_monitor.cpp
+ *
+ * \brief Source for block_load_monitor class
+ *
+ * \class block_load_monitor
+ *
+ */
+
+#include "block_load_monitor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+block_load_monitor::block_load_monitor(){
+    for (auto& bucket : buckets) bucket.store(0);
+    blocks.store(0);
+    deadline_misses.store(0);
+    load_sum.store(0);
+    load_max.store(0);
+    reset_requested.store(false);
+    load_per_tick_and_sample.store(0.0);
+}
+
+double block_load_monitor::ticks_per_second(){
+#if defined(__x86_64__) || defined(__i386__)
+    // assumes an invariant time stamp counter, which all x86 CPUs of the last decade have
+    static const double frequency = [](){
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t startTicks = read_ticks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        const uint64_t endTicks = read_ticks();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return (double) (endTicks - startTicks) / seconds;
+    }();
+    return frequency;
+#else
+    return 1.0e9;
+#endif
+}
+
+void block_load_monitor::prepare(double sampleRate){
+    // load = ticks / (numSamples / sampleRate * ticks_per_second), in fixed point
+    load_per_tick_and_sample.store(sampleRate / ticks_per_second() * (double) (uint64_t{1} << load_fraction_bits));
+    request_reset();
+}
+
+block_load_monitor::statistics block_load_monitor::get_statistics() const{
+    uint64_t counts[num_buckets];
+    get_bucket_counts(counts);
+    const double scale = 1.0 / (double) (uint64_t{1} << load_fraction_bits);
+
+    statistics result;
+    result.blocks = blocks.load(std::memory_order_acquire);
+    result.deadline_misses = deadline_misses.load(std::memory_order_relaxed);
+    result.max = (double) load_max.load(std::memory_order_relaxed) * scale;
+    result.mean = result.blocks > 0 ? (double) load_sum.load(std::memory_order_relaxed) * scale / (double) result.blocks : 0.0;
+
+    uint64_t total = 0;
+    for (uint64_t count : counts) total += count;
+
+    // the upper end of the bucket that holds the quantile, but never more than the largest load
+    auto quantile = [&](double q){
+        if (total == 0) return 0.0;
+        const uint64_t rank = (uint64_t) std::ceil(q * (double) total);
+        uint64_t cumulative = 0;
+        for (int i = 0; i < num_buckets; i++){
+            cumulative += counts[i];
+            if (cumulative >= rank) return std::min(i + 1 < num_buckets ? get_bucket_load(i + 1) : get_bucket_load(i), result.max);
+        }
+        return result.max;
+    };
+    result.p99 = quantile(0.99);
+    result.p999 = quantile(0.999);
+    return result;
+}
+
+void block_load_monitor::get_bucket_counts(uint64_t* counts) const{
+    for (int i = 0; i < num_buckets; i++) counts[i] = buckets[i].load(std::memory_order_relaxed);
+}
+
+double block_load_monitor::get_bucket_load(int index){
+    uint64_t load;
+    if (index < (1 << sub_bucket_bits)) load = (uint64_t) index;
+    else{
+        const int shift = (index >> (sub_bucket_bits - 1)) - 1;
+        load = (uint64_t) (index - (shift << (sub_bucket_bits - 1))) << shift;
+    }
+    return (double) load / (double) (uint64_t{1} << load_fraction_bits);
+}
+
+void block_load_monitor::request_reset(){
+    reset_requested.store(true, std::memory_order_release);
+}
@@ -0,0 +1,134 @@
+/**
+ * \file block_load_monitor.h
+ *
+ * \brief Measures how long processBlock takes relative to the time the block represents.
+ *
+ * \details The audio thread reads the time stamp counter at the start and the end of every block and passes the difference to block_load_monitor::record. The load of a block is its processing time divided by its deadline (numSamples / sampleRate), a load above 1 is a deadline miss. The loads are accumulated in a log-linear histogram with about 3 % resolution from 1/4096 up to 2048 times the deadline, like an HDR histogram.
+ *
+ * There is a single writer, the audio thread, which only does relaxed loads and stores of atomics and never waits. Any other thread (the editor, the standalone app, a telemetry publisher) can call block_load_monitor::get_statistics at any time. A reader may see a block counted in the histogram but not yet in the sum, which is irrelevant for the statistics. Resets are requested by readers and done by the audio thread at the start of the next block.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#ifndef block_load_monitor_h
+#define block_load_monitor_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+class block_load_monitor{
+public:
+    /// the smallest 2^sub_bucket_bits loads have a bucket each, every octave above is split into 2^(sub_bucket_bits-1) buckets
+    static constexpr int sub_bucket_bits = 6;
+    /// loads are recorded as fixed point numbers with this many fractional bits
+    static constexpr int load_fraction_bits = 12;
+    /// loads up to 2^(max_load_bits+1) deadlines are recorded, larger ones are counted as the largest
+    static constexpr int max_load_bits = 10;
+    static constexpr int num_buckets = (load_fraction_bits + max_load_bits - sub_bucket_bits + 3) << (sub_bucket_bits - 1);
+
+    /// \brief Statistics of the recorded blocks, loads are fractions of the block deadline
+    struct statistics{
+        uint64_t blocks;
+        uint64_t deadline_misses;
+        double mean;
+        double p99;
+        double p999;
+        double max;
+    };
+
+    block_load_monitor();
+
+    /// \brief block_load_monitor::read_ticks Reads the time stamp counter (the steady clock in ns where there is none)
+    static inline uint64_t read_ticks(){
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    /// \brief block_load_monitor::ticks_per_second Frequency of read_ticks, measured once against the steady clock
+    static double ticks_per_second();
+
+    /// \brief block_load_monitor::prepare Sets the sample rate the deadlines are computed with, not real-time safe
+    /// \param sampleRate the sample rate
+    void prepare(double sampleRate);
+
+    /// \brief block_load_monitor::record Records one block, called by the audio thread only
+    /// \param ticks the processing time in read_ticks units
+    /// \param numSamples the number of samples of the block
+    inline void record(uint64_t ticks, int numSamples);
+
+    /// \brief block_load_monitor::get_statistics Computes the statistics of the blocks recorded since the last reset, may be called from any thread
+    statistics get_statistics() const;
+
+    /// \brief block_load_monitor::get_bucket_counts Copies the histogram, may be called from any thread
+    /// \param counts array of num_buckets counts
+    void get_bucket_counts(uint64_t* counts) const;
+
+    /// \brief block_load_monitor::get_bucket_load Gets the smallest load counted in a bucket
+    static double get_bucket_load(int index);
+
+    /// \brief block_load_monitor::request_reset Clears the statistics before the next recorded block, may be called from any thread
+    void request_reset();
+
+private:
+    static inline int bucket_index(uint64_t load);
+    inline void add(std::atomic<uint64_t>& counter, uint64_t value);
+
+    std::atomic<uint64_t> buckets[num_buckets];
+    std::atomic<uint64_t> blocks;
+    std::atomic<uint64_t> deadline_misses;
+    std::atomic<uint64_t> load_sum;
+    std::atomic<uint64_t> load_max;
+    std::atomic<bool> reset_requested;
+    /// fixed point load of one tick per sample
+    std::atomic<double> load_per_tick_and_sample;
+};
+
+inline void block_load_monitor::add(std::atomic<uint64_t>& counter, uint64_t value){
+    // single writer, so a plain load and store is enough
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline int block_load_monitor::bucket_index(uint64_t load){
+    constexpr uint64_t largest = (uint64_t{1} << (load_fraction_bits + max_load_bits + 1)) - 1;
+    if (load > largest) load = largest;
+    if (load < (uint64_t{1} << sub_bucket_bits)) return (int) load;
+
+    int msb = 63;
+    while ((load >> msb) == 0) msb--;
+    const int shift = msb - (sub_bucket_bits - 1);
+    return (shift << (sub_bucket_bits - 1)) + (int) (load >> shift);
+}
+
+inline void block_load_monitor::record(uint64_t ticks, int numSamples){
+    if (numSamples <= 0) return;
+
+    if (reset_requested.load(std::memory_order_acquire)){
+        for (auto& bucket : buckets) bucket.store(0, std::memory_order_relaxed);
+        blocks.store(0, std::memory_order_relaxed);
+        deadline_misses.store(0, std::memory_order_relaxed);
+        load_sum.store(0, std::memory_order_relaxed);
+        load_max.store(0, std::memory_order_relaxed);
+        reset_requested.store(false, std::memory_order_release);
+    }
+
+    const uint64_t load = (uint64_t) ((double) ticks * load_per_tick_and_sample.load(std::memory_order_relaxed) / numSamples);
+
+    add(buckets[bucket_index(load)], 1);
+    add(load_sum, load);
+    if (load > load_max.load(std::memory_order_relaxed)) load_max.store(load, std::memory_order_relaxed);
+    if (load > (uint64_t{1} << load_fraction_bits)) add(deadline_misses, 1);
+    // counted last, so that readers see a block at most in the histogram before it is in the count
+    blocks.store(blocks.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+#endif /* block_load_monitor_h */
@@ -9,147 +9,136 @@
 
 #include "comb_filter.h"
 
-comb_filter::comb_filter(){
+#include <cstring>
+
+template <typename Storage, typename Interpolation>
+basic_comb_filter<Storage, Interpolation>::basic_comb_filter(){
     filtered_output = 0.f;
-    bufidx_read = 0.f;
     bufidx_write = 0;
-    buffer_step = 1.f;
-    decreaser = -1.f;
-    increaser = 0.f;
-    write_done = false;
-    read_done = false;
-    step_diff = 0.f;
+    mask = 0;
+    delay = 0.f;
+    bufsize = 0.f;
+    dither_state = 22222u;
 }
 
-float comb_filter::process(float input){
-    float output;
+template <typename Storage, typename Interpolation>
+void basic_comb_filter<Storage, Interpolation>::initBuffer(int bufsizeIn){
+    // room for the older interpolation points behind the longest delay
+    unsigned long capacity = 1;
+    while (capacity < (unsigned long) bufsizeIn + Interpolation::older_taps + 1) capacity <<= 1;
     
-    if (bufsize > oldbufsize){
-        step_diff = bufsize - oldbufsize;
-
-        if ((int) (step_diff - decreaser * 0.5f) > 0.1f){
-            decreaser += 1;
-            buffer_step = 0.5f;
-        }
-        else{
-            buffer_step = 1.f;
-            if (write_done){
-                decreaser = -1.f;
-                bufidx_read = (float) bufidx_write;
-                write_done = false;
-                read_done = false;
-                read_new_bufsize = false;
-                step_diff = 0.f;
-                oldbufsize = bufsize;
-            }
-        }
-        if (bufidx_write >= bufsize - 1){
-            write_done = true;
-            read_new_bufsize = true;
-        }
-//        std::cout << "CF 1: " << "bufidx_read: " << bufidx_read << ", bufidx_write: " << bufidx_write << ", oldbufsize: " << oldbufsize << ", bufsize: " << bufsize << ", difference " << step_diff - decreaser * 0.5f << std::endl;
-    }
-
-    else if (bufsize < oldbufsize){
-        if (step_diff == 0){
-            if (bufidx_write > bufsize){
-                bufsize_written = bufidx_write;
-            }
-            else bufsize_written = bufsize;
-        }
-        step_diff = oldbufsize - bufsize_written;
-        if ((int) (step_diff - increaser) >= 0.1f){
-            increaser += 1;
-            buffer_step = 2.f;
-        }
-        else{
-            buffer_step = 1.f;
-            if (read_done){
-                increaser = 0.f;
-                bufidx_read = (float) bufidx_write;
-                read_done = false;
-                write_done = false;
-                step_diff = 0.f;
-                read_new_bufsize = false;
-                oldbufsize = bufsize;
-            }
-        }
-        if ((int) bufidx_read >= oldbufsize - 2) {
-            read_done = true;
-            read_new_bufsize = true;
-        }
-//        std::cout << "CF 2: " << "bufidx_read: " << bufidx_read << ", bufidx_write: " << bufidx_write << ", oldbufsize: " << oldbufsize << ", bufsize: " << bufsize << ", difference " << step_diff - increaser << ", read_done: " << read_done << std::endl;
-    }
-    
-    // whats actually done
-    output = read_buffer(bufidx_read, buffer_step);
-    buffer[bufidx_write] = input - (filtered_output*feedback);
-    filtered_output = filtered_output + (1-damp)*(output-filtered_output);
-    
-    bufidx_read = bufidx_read + buffer_step;
-    bufidx_write = bufidx_write + 1;
-
-    if (not read_new_bufsize) {if(bufidx_read >= (float) oldbufsize) bufidx_read = 0;}
-    else {if(bufidx_read >= (float) bufsize) bufidx_read = 0;}
-    if(bufidx_write>=bufsize) bufidx_write = 0;
-
-    return output;
-}
-
-float comb_filter::read_buffer(float idx, float buffer_step){
-    float alpha = idx - (int) idx;
-    int idx_2 = (int) idx + 1;
-    if (idx_2 >= (float) oldbufsize && not read_new_bufsize) idx_2 = 0;
-    if (read_new_bufsize && idx_2 >= (float) bufsize) idx_2 = 0;
-    if (buffer_step <= 1.f) return (1-alpha) * buffer[(int) idx] + alpha * buffer[idx_2];
-    else return 0.5f * (buffer[(int) idx] + buffer[idx_2]);
+    buffer.assign(capacity, 0);
+    mask = capacity - 1;
+    bufidx_write = 0;
+    delay = 0.f;
 }
 
-void comb_filter::initBuffer(int bufsizeIn){
-    buffer.clear();
-    for (int i = 0; i <= bufsizeIn; i++) {
-        buffer.push_back(0.0f);
+template <typename Storage, typename Interpolation>
+void basic_comb_filter<Storage, Interpolation>::setbuffer(int bufsizeIn){
+    // without a delay line from initBuffer there is no range to clamp to
+    if (mask == 0)
+        return;
+    // the newer interpolation points must already be written, a delay line too short for the interpolation keeps the shortest delay
+    const int shortest = Interpolation::newer_taps + 1;
+    bufsize = (float) std::clamp(bufsizeIn, shortest, std::max(shortest, (int) mask - Interpolation::older_taps));
+    // the first buffersize after initBuffer is taken over without resizing
+    if (delay == 0.f){
+        delay = bufsize;
     }
 }
 
-void comb_filter::setbuffer(int bufsizeIn){
-    if (oldbufsize == 0){
-        oldbufsize = bufsizeIn;
-    }
-    else{
-        oldbufsize = bufsize;
+template <typename Storage, typename Interpolation>
+void basic_comb_filter<Storage, Interpolation>::mute(){
+    for (auto & sample : buffer){
+        sample = 0;
     }
-    bufsize = bufsizeIn;
 }
 
-void comb_filter::mute(){
-    for (float & sample : buffer){
-        sample = 0;
-    }
+template <typename Storage, typename Interpolation>
+void basic_comb_filter<Storage, Interpolation>::reset(){
+    std::fill(buffer.begin(), buffer.end(), 0);
+    bufidx_write = 0;
+    delay = bufsize;
+    filtered_output = 0.f;
+    dither_state = 22222u;
+    interpolator = Interpolation();
 }
 
-void comb_filter::setdamp(float val){
+template <typename Storage, typename Interpolation>
+void basic_comb_filter<Storage, Interpolation>::setdamp(float val){
     damp = val;
 }
 
-float comb_filter::getdamp(){
+template <typename Storage, typename Interpolation>
+float basic_comb_filter<Storage, Interpolation>::getdamp(){
     return damp;
 }
 
-void comb_filter::setfeedback(float val){
+template <typename Storage, typename Interpolation>
+void basic_comb_filter<Storage, Interpolation>::setfeedback(float val){
     feedback = val;
 }
 
-float comb_filter::getfeedback(){
+template <typename Storage, typename Interpolation>
+float basic_comb_filter<Storage, Interpolation>::getfeedback(){
     return feedback;
 }
 
-bool comb_filter::ready(){
-    if (step_diff == 0.f){
-//        std::cout << "true" << std::endl;
-        return true;
-    }
-    else{
-        return false;
-    }
+template <typename Storage, typename Interpolation>
+bool basic_comb_filter<Storage, Interpolation>::ready(){
+    return delay == bufsize;
+}
+
+template <typename Storage, typename Interpolation>
+size_t basic_comb_filter<Storage, Interpolation>::statesize() const{
+    return sizeof(scalar_state) + buffer.size() * sizeof(typename Storage::sample_type);
 }
+
+template <typename Storage, typename Interpolation>
+void basic_comb_filter<Storage, Interpolation>::savestate(unsigned char* destination) const{
+    scalar_state scalars;
+    scalars.bufidx_write = bufidx_write;
+    scalars.delay = delay;
+    scalars.bufsize = bufsize;
+    scalars.filtered_output = filtered_output;
+    scalars.dither_state = dither_state;
+    scalars.interpolator = interpolator;
+    std::memcpy(destination, &scalars, sizeof(scalars));
+    std::memcpy(destination + sizeof(scalars), buffer.data(), buffer.size() * sizeof(typename Storage::sample_type));
+}
+
+template <typename Storage, typename Interpolation>
+void basic_comb_filter<Storage, Interpolation>::loadstate(const unsigned char* source, prepared_state& state) const{
+    state.buffer.resize(buffer.size());
+    std::memcpy(&state.scalars, source, sizeof(state.scalars));
+    std::memcpy(state.buffer.data(), source + sizeof(state.scalars), buffer.size() * sizeof(typename Storage::sample_type));
+}
+
+template <typename Storage, typename Interpolation>
+void basic_comb_filter<Storage, Interpolation>::swapstate(prepared_state& state){
+    if (state.buffer.size() != buffer.size())
+        return;
+    buffer.swap(state.buffer);
+    bufidx_write = state.scalars.bufidx_write & mask;
+    delay = state.scalars.delay;
+    bufsize = state.scalars.bufsize;
+    filtered_output = state.scalars.filtered_output;
+    dither_state = state.scalars.dither_state;
+    interpolator = state.scalars.interpolator;
+}
+
+template class basic_comb_filter<float_storage, none_interpolation>;
+template class basic_comb_filter<float_storage, linear_interpolation>;
+template class basic_comb_filter<float_storage, hermite_interpolation>;
+template class basic_comb_filter<float_storage, thiran_interpolation>;
+template class basic_comb_filter<float_storage, sinc_interpolation>;
+template class basic_comb_filter<half_storage, none_interpolation>;
+template class basic_comb_filter<half_storage, linear_interpolation>;
+template class basic_comb_filter<half_storage, hermite_interpolation>;
+template class basic_comb_filter<half_storage, thiran_interpolation>;
+template class basic_comb_filter<half_storage, sinc_interpolation>;
+template class basic_comb_filter<int16_storage, none_interpolation>;
+template class basic_comb_filter<int16_storage, linear_interpolation>;
+template class basic_comb_filter<int16_storage, hermite_interpolation>;
+template class basic_comb_filter<int16_storage, thiran_interpolation>;
+template class basic_comb_filter<int16_storage, sinc_interpolation>;
@@ -3,11 +3,11 @@
  *
  * \brief Header for comb_filter class
  *
- * \class comb_filter
+ * \class basic_comb_filter
  *
  * \brief Class defining a lowpass feedback comb filter.
  *
- * \details This filter is a simple feedback comb filter, whose feedback is feeded into a simple lowpass filter.
+ * \details This filter is a simple feedback comb filter, whose feedback is feeded into a simple lowpass filter. The sample format of the delay line is given by the Storage template parameter (see delay_storage.h), the interpolation while resizing by the Interpolation template parameter (see interpolation.h). comb_filter is the instance used by the plugin.
  *
  * \author Fares Schulz
  *
@@ -18,27 +18,35 @@
 #ifndef comb_filter_h
 #define comb_filter_h
 
-#include <iostream>
 #include <vector>
+#include <algorithm>
+#include "delay_storage.h"
+#include "interpolation.h"
 
-class comb_filter{
+template <typename Storage, typename Interpolation = linear_interpolation>
+class basic_comb_filter{
     
 public:
     /// \brief comb_filter::comb_filter The constructor
-    comb_filter();
+    basic_comb_filter();
     
     /// \brief comb_filter::setbuffer Sets the buffersize
+    /// \details The buffersize is the logical delay length, the delay line moves towards it over the following samples (see comb_filter::ready). Ignored before comb_filter::initBuffer.
     /// \param bufsizeIn the desired bufsize
     void setbuffer(int bufsizeIn);
     
     /// \brief comb_filter::process The actual processing method
     /// \param input single sample input [float]
     /// \return the processed output [float]
-    float process(float input);
+    inline float process(float input);
     
     /// \brief comb_filter::mute Mutes the buffer
     void mute();
     
+    /// \brief comb_filter::reset Clears the buffer and the filter state and takes over the buffersize set by comb_filter::setbuffer without resizing
+    /// \details After reset the filter processes like a filter that was just initialized with this buffersize, the buffer is not reallocated.
+    void reset();
+    
     /// \brief comb_filter::setdamp Sets the dampening factor
     /// \param val the desired dampening value
     void setdamp(float val);
@@ -56,30 +64,110 @@ public:
     float getfeedback();
     
     /// \brief comb_filter::initBuffer Initializes the buffer
-    /// \details First the the buffer vector gets cleared and then the longest possible buffersize is written with zeros.
-    /// \param bufsizeIn the initial buffersize
+    /// \details The buffer is allocated with zeros at the next power of two that holds the longest possible buffersize, so that the read and write positions can be wrapped with a bitmask.
+    /// \param bufsizeIn the longest possible buffersize
     void initBuffer(int bufsizeIn);
+    
+    /// \brief comb_filter::ready Checks whether the delay line has reached the buffersize set by comb_filter::setbuffer
+    /// \return true if no resize is in progress
     bool ready();
     
+    /// \brief comb_filter::statesize Gets the number of bytes comb_filter::savestate writes, the delay line and the filter state
+    size_t statesize() const;
+    
+    /// \brief comb_filter::savestate Copies the delay line and the filter state, the feedback and dampening belong to the parameters and are not saved
+    /// \param destination at least comb_filter::statesize bytes
+    void savestate(unsigned char* destination) const;
+    
+    struct prepared_state;
+    
+    /// \brief comb_filter::loadstate Unpacks a state saved by a filter with the same longest buffersize, for comb_filter::swapstate
+    /// \details Allocates the delay line of state on its first use and copies the whole delay line, call it outside the audio thread.
+    /// \param source the bytes written by comb_filter::savestate
+    /// \param state receives the delay line and the filter state
+    void loadstate(const unsigned char* source, prepared_state& state) const;
+    
+    /// \brief comb_filter::swapstate Restores a state unpacked by comb_filter::loadstate without copying the delay line
+    /// \details The delay lines are swapped, afterwards state holds the previous delay line of the filter.
+    /// \param state unpacked by comb_filter::loadstate of this filter
+    void swapstate(prepared_state& state);
+    
 private:
     float feedback;
     float damp;
     float filtered_output;
-    std::vector<float> buffer;
-    unsigned long bufsize;
-    unsigned long bufsize_written;
-    unsigned long oldbufsize = 0;
-    float bufidx_read;
+    std::vector<typename Storage::sample_type> buffer;
+    uint32_t dither_state;
+    /// bitmask that wraps positions in the power-of-two buffer
+    unsigned long mask;
     unsigned long bufidx_write;
-    float read_buffer(float value, float buffer_step);
-    float buffer_step;
-    float decreaser;
-    float increaser;
-    bool write_done;
-    bool read_done;
-    bool read_new_bufsize = false;
-    float step_diff;
+    /// current delay length in samples, fractional while the delay line is resized
+    float delay;
+    /// delay length set by comb_filter::setbuffer
+    float bufsize;
+    /// \brief comb_filter::read_buffer Reads the sample that was written delay samples ago
+    /// \param delay the delay in samples
+    /// \param buffer_step read speed relative to the write speed (0.5 while growing, 2 while shrinking and 1 otherwise)
+    inline float read_buffer(float delay, float buffer_step);
+    /// fractional delay interpolation used while resizing
+    Interpolation interpolator;
+    /// \brief Everything but the delay line that comb_filter::savestate copies
+    struct scalar_state{
+        unsigned long bufidx_write;
+        float delay;
+        float bufsize;
+        float filtered_output;
+        uint32_t dither_state;
+        Interpolation interpolator;
+    };
+    
+public:
+    /// \brief A state unpacked by comb_filter::loadstate, taken over by comb_filter::swapstate
+    struct prepared_state{
+        std::vector<typename Storage::sample_type> buffer;
+        scalar_state scalars;
+    };
 };
 
+template <typename Storage, typename Interpolation>
+float basic_comb_filter<Storage, Interpolation>::process(float input){
+    float output;
+    
+    // While resizing, the read position moves with half speed (growing) or double speed (shrinking) until the new delay is reached.
+    if (delay == bufsize){
+        output = read_buffer(delay, 1.f);
+    }
+    else if (delay < bufsize){
+        output = read_buffer(delay, 0.5f);
+        delay = std::min(delay + 0.5f, bufsize);
+    }
+    else{
+        output = read_buffer(delay, 2.f);
+        delay = std::max(delay - 1.f, bufsize);
+    }
+    
+    // whats actually done
+    buffer[bufidx_write] = Storage::encode(input - (filtered_output*feedback), dither_state);
+    filtered_output = filtered_output + (1-damp)*(output-filtered_output);
+    
+    bufidx_write = (bufidx_write + 1) & mask;
+
+    return output;
+}
+
+template <typename Storage, typename Interpolation>
+float basic_comb_filter<Storage, Interpolation>::read_buffer(float delay, float buffer_step){
+    const unsigned long idx = (unsigned long) delay;
+    const unsigned long position = (bufidx_write - idx) & mask;
+    if (buffer_step == 1.f){
+        const float sample = Storage::decode(buffer[position]);
+        interpolator.track(sample);
+        return sample;
+    }
+    return interpolator.template read<Storage>(buffer.data(), mask, position, delay - (float) idx, buffer_step);
+}
+
+/// the comb_filter used by the plugin, stores its delay line in the format selected by REVERB_DELAY_STORAGE and interpolates as selected by REVERB_DELAY_INTERPOLATION
+using comb_filter = basic_comb_filter<delay_storage, delay_interpolation>;
 
 #endif /* comb_filter_h */
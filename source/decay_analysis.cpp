@@ -0,0 +1,72 @@
+/**
+ * \file decay_analysis.cpp
+ *
+ * \brief Source for the room acoustic parameters
+ *
+ */
+
+#include "decay_analysis.h"
+
+#include <cmath>
+#include <limits>
+
+namespace decay_analysis
+{
+    namespace
+    {
+        constexpr double not_available = std::numeric_limits<double>::quiet_NaN();
+
+        /// \brief Fits a line to the decay curve between two levels and extrapolates the time of a 60 dB decay
+        double decay_time(const std::vector<double>& curve, double sample_rate, double upper, double lower){
+            size_t begin = 0;
+            while (begin < curve.size() && curve[begin] > upper) begin++;
+            size_t end = begin;
+            while (end < curve.size() && curve[end] >= lower) end++;
+            // the curve never fell below the lower level
+            if (end == curve.size() || end - begin < 2) return not_available;
+
+            // least squares over the samples in between, with the time in samples
+            double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumXY = 0.0;
+            const double n = (double) (end - begin);
+            for (size_t i = begin; i < end; i++){
+                const double x = (double) i;
+                sumX += x;
+                sumY += curve[i];
+                sumXX += x * x;
+                sumXY += x * curve[i];
+            }
+            const double slope = (n * sumXY - sumX * sumY) / (n * sumXX - sumX * sumX);
+            return slope < 0.0 ? -60.0 / slope / sample_rate : not_available;
+        }
+    }
+
+    void energy_decay_curve(const float* impulse_response, size_t length, std::vector<double>& curve){
+        curve.resize(length);
+        double energy = 0.0;
+        for (size_t i = length; i-- > 0;){
+            energy += (double) impulse_response[i] * (double) impulse_response[i];
+            curve[i] = energy;
+        }
+        const double total = length > 0 ? curve[0] : 0.0;
+        for (double& value : curve) value = total > 0.0 && value > 0.0 ? 10.0 * std::log10(value / total) : -std::numeric_limits<double>::infinity();
+    }
+
+    parameters analyse(const float* impulse_response, size_t length, double sample_rate){
+        std::vector<double> curve;
+        energy_decay_curve(impulse_response, length, curve);
+
+        parameters result;
+        result.rt60 = decay_time(curve, sample_rate, -5.0, -35.0);
+        if (std::isnan(result.rt60)) result.rt60 = decay_time(curve, sample_rate, -5.0, -25.0);
+        result.edt = decay_time(curve, sample_rate, 0.0, -10.0);
+
+        double early = 0.0, late = 0.0;
+        const size_t boundary = (size_t) std::lround(0.08 * sample_rate);
+        for (size_t i = 0; i < length; i++){
+            const double energy = (double) impulse_response[i] * (double) impulse_response[i];
+            (i < boundary ? early : late) += energy;
+        }
+        result.c80 = early + late > 0.0 ? 10.0 * std::log10(early / late) : not_available;
+        return result;
+    }
+}
@@ -0,0 +1,37 @@
+/**
+ * \file decay_analysis.h
+ *
+ * \brief Room acoustic parameters of an impulse response after ISO 3382-1.
+ *
+ * \details The energy decay curve is the backward (Schroeder) integral of the squared impulse response, computed in a single pass from the end. The reverberation time is extrapolated to 60 dB from a least squares fit of the decay curve between -5 and -35 dB (T30), or between -5 and -25 dB (T20) if the curve does not fall that far. The early decay time uses the fit between 0 and -10 dB, the clarity C80 is the ratio of the energy before and after 80 ms. The impulse response is expected to start at the time of the excitation and to be long enough for its level to fall by more than 35 dB, the end of the decay curve bends down because the integral is truncated there.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#ifndef decay_analysis_h
+#define decay_analysis_h
+
+#include <cstddef>
+#include <vector>
+
+namespace decay_analysis
+{
+    struct parameters{
+        /// reverberation time in seconds, NaN if the decay curve does not reach -25 dB
+        double rt60;
+        /// early decay time in seconds, NaN if the decay curve does not reach -10 dB
+        double edt;
+        /// clarity in dB, NaN if the impulse response is silent
+        double c80;
+    };
+
+    /// \brief Computes the energy decay curve in dB relative to the total energy, -infinity after the last non-zero sample
+    void energy_decay_curve(const float* impulse_response, size_t length, std::vector<double>& curve);
+
+    /// \brief Computes the room acoustic parameters of an impulse response
+    parameters analyse(const float* impulse_response, size_t length, double sample_rate);
+}
+
+#endif /* decay_analysis_h */
@@ -0,0 +1,125 @@
+/**
+ * \file delay_storage.h
+ *
+ * \brief Sample formats for the delay lines of the comb_filter and allpass_filter instances.
+ *
+ * \details At high ambisonic orders the delay lines of the diffuse model do not fit into the caches anymore and the processing gets bound by memory bandwidth. The storage formats defined here allow to keep the delay lines in a compact 16 bit format, which halves the cache footprint. Samples are only converted to float when they are read into registers, all arithmetic is still done in float.
+ *
+ * The compact formats are not a speed option. The conversions cost more than the smaller footprint saves in reverb_storage_bench (63 channels, one noise burst and its tail): half_storage runs at about 0.7 to 0.9 times the speed of float_storage with F16C and at about 0.2 times with the software conversion, int16_storage at about 0.4 to 0.5 times. The noise floors relative to the float render are -66 dB for half_storage and -45 dB for int16_storage. They are meant for configurations that are bound by memory bandwidth, where they have to be measured against float_storage before they are used.
+ *
+ * The format used by the plugin is chosen at compile time with the REVERB_DELAY_STORAGE definition (float_storage, half_storage or int16_storage), float_storage is the default.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#ifndef delay_storage_h
+#define delay_storage_h
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#if defined(__F16C__)
+    #include <immintrin.h>
+#endif
+
+/// \brief Stores the delay line samples as 32 bit floats (reference format)
+struct float_storage{
+    using sample_type = float;
+
+    static inline sample_type encode(float value, uint32_t&) { return value; }
+    static inline float decode(sample_type value) { return value; }
+};
+
+/// \brief Stores the delay line samples as IEEE 754 half floats
+/// \details Uses the F16C instructions when the target supports them (-mf16c), otherwise a portable bit conversion with round to nearest even.
+struct half_storage{
+    using sample_type = uint16_t;
+
+    static inline sample_type encode(float value, uint32_t&){
+#if defined(__F16C__)
+        return _cvtss_sh(value, 0);
+#else
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        const uint32_t sign = (bits >> 16) & 0x8000u;
+        const uint32_t abs = bits & 0x7fffffffu;
+
+        // NaN and infinity
+        if (abs >= 0x7f800000u) return (sample_type) (sign | 0x7c00u | (abs > 0x7f800000u ? 0x200u : 0u));
+        // overflow to infinity
+        if (abs >= 0x477ff000u) return (sample_type) (sign | 0x7c00u);
+        // normal half floats
+        if (abs >= 0x38800000u){
+            const uint32_t rounded = abs + 0xfffu + ((abs >> 13) & 1u);
+            return (sample_type) (sign | ((rounded - 0x38000000u) >> 13));
+        }
+        // subnormal half floats and zero
+        if (abs < 0x33000000u) return (sample_type) sign;
+        const uint32_t shift = 126u - (abs >> 23);
+        const uint32_t mantissa = (abs & 0x7fffffu) | 0x800000u;
+        const uint32_t halfway = 1u << (shift - 1);
+        uint32_t result = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        if (remainder > halfway || (remainder == halfway && (result & 1u))) result++;
+        return (sample_type) (sign | result);
+#endif
+    }
+
+    static inline float decode(sample_type value){
+#if defined(__F16C__)
+        return _cvtsh_ss(value);
+#else
+        const uint32_t sign = (uint32_t) (value & 0x8000u) << 16;
+        const uint32_t exponent = (value >> 10) & 0x1fu;
+        const uint32_t mantissa = value & 0x3ffu;
+        uint32_t bits;
+        if (exponent == 0x1fu) bits = sign | 0x7f800000u | (mantissa << 13);
+        else if (exponent != 0) bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+        else{
+            // subnormal half floats are normal floats
+            float result = (float) mantissa * 5.9604644775390625e-8f;
+            return sign ? -result : result;
+        }
+        float result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result;
+#endif
+    }
+};
+
+/// \brief Stores the delay line samples as scaled 16 bit integers with TPDF dither
+/// \details The delay lines of the combs with a high feedback carry more than full scale, and the allpass_filter chain gets the sum of all combs, which exceeds +-8 for a sustained sine sweep. The integer range is therefore mapped to +-16, at a dither floor 6 dB above the one of +-8. Values outside of that range are clipped.
+struct int16_storage{
+    using sample_type = int16_t;
+
+    /// largest magnitude that can be stored without clipping
+    static constexpr float headroom = 16.f;
+    static constexpr float scale = 32767.f / headroom;
+
+    static inline sample_type encode(float value, uint32_t& dither_state){
+        // two uniform random values from a linear congruential generator give a triangular dither of +-1 LSB
+        dither_state = dither_state * 1664525u + 1013904223u;
+        const float r1 = (float) (dither_state >> 8) * (1.f / 16777216.f);
+        dither_state = dither_state * 1664525u + 1013904223u;
+        const float r2 = (float) (dither_state >> 8) * (1.f / 16777216.f);
+
+        float scaled = value * scale + (r1 - r2);
+        if (scaled > 32767.f) scaled = 32767.f;
+        if (scaled < -32767.f) scaled = -32767.f;
+        return (sample_type) std::lrintf(scaled);
+    }
+
+    static inline float decode(sample_type value) { return (float) value * (1.f / scale); }
+};
+
+#ifndef REVERB_DELAY_STORAGE
+    #define REVERB_DELAY_STORAGE float_storage
+#endif
+
+/// sample format of the delay lines used by the plugin
+using delay_storage = REVERB_DELAY_STORAGE;
+
+#endif /* delay_storage_h */
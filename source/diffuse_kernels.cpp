@@ -0,0 +1,194 @@
+/**
+ * \file diffuse_kernels.cpp
+ *
+ * \brief Source for the diffuse model kernels
+ *
+ * \details Every kernel is written once as an inline function and wrapped by one small function per instruction set. On x86 with GCC or Clang the wrappers carry a target attribute, so the compiler generates code for that instruction set for everything that is inlined into them (the flatten attribute makes sure the comb_filter and allpass_filter processing is). Code that is not inlined is compiled for the baseline and stays safe to call on every CPU. This file is compiled with -ffp-contract=off, so that the AVX-512 variant does not fuse multiplications and additions and all variants round the same way.
+ *
+ */
+
+#include "diffuse_kernels.h"
+#include "tuning.h"
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && ! defined(REVERB_NO_RUNTIME_DISPATCH)
+    #define REVERB_X86_DISPATCH 1
+    #define REVERB_KERNEL(isa) __attribute__((flatten, target(isa)))
+#else
+    #define REVERB_X86_DISPATCH 0
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define REVERB_KERNEL_GENERIC __attribute__((flatten))
+#else
+    #define REVERB_KERNEL_GENERIC
+#endif
+
+namespace diffuse_kernels
+{
+    namespace
+    {
+        inline void process_channel_impl(comb_filter* combs, int numCombs, allpass_filter* allpasses, int numAllpasses, const float* input, float* output, float* outputACN0, int numSamples, const channel_gains& gains, bool initACN0)
+        {
+            auto diffuse = [&](float in) {
+                const float combInput = gains.input * in;
+                float out = 0.f;
+                for(int j = 0; j<numCombs; j++){
+                    out += combs[j].process(combInput);
+                }
+                for(int j = 0; j<numAllpasses; j++){
+                    out = allpasses[j].process(out);
+                }
+                return out * gains.output;
+            };
+
+            if (initACN0) {
+                for(int sample = 0; sample < numSamples; ++sample)
+                {
+                    const float out = diffuse(input[sample]);
+                    output[sample] = out;
+                    outputACN0[sample] = out * gains.ACN0 + gains.dry * input[sample];
+                }
+            }
+            else {
+                for(int sample = 0; sample < numSamples; ++sample)
+                {
+                    const float out = diffuse(input[sample]);
+                    output[sample] = out;
+                    outputACN0[sample] += out * gains.ACN0;
+                }
+            }
+        }
+
+        // comb_bank_impl, allpass_chain_impl and add_scaled_impl do the same operations in the same order as process_channel_impl
+        inline void comb_bank_impl(comb_filter* combs, int numCombs, const float* input, float* output, int numSamples, float gain)
+        {
+            for(int sample = 0; sample < numSamples; ++sample)
+            {
+                const float combInput = gain * input[sample];
+                float out = 0.f;
+                for(int j = 0; j<numCombs; j++){
+                    out += combs[j].process(combInput);
+                }
+                output[sample] = out;
+            }
+        }
+
+        inline void allpass_chain_impl(allpass_filter* allpasses, int numAllpasses, float* samples, int numSamples, float gain)
+        {
+            for(int sample = 0; sample < numSamples; ++sample)
+            {
+                float out = samples[sample];
+                for(int j = 0; j<numAllpasses; j++){
+                    out = allpasses[j].process(out);
+                }
+                samples[sample] = out * gain;
+            }
+        }
+
+        inline void add_scaled_impl(const float* __restrict input, float* __restrict output, int numSamples, float gain)
+        {
+            for(int sample = 0; sample < numSamples; ++sample) output[sample] += input[sample] * gain;
+        }
+
+        inline void mix_impl(const float* const* inputs, int numInputs, float* __restrict output, int numSamples, float gain)
+        {
+            if (numInputs == 0) {
+                for(int sample = 0; sample < numSamples; ++sample) output[sample] = 0.f;
+                return;
+            }
+
+            const float* __restrict first = inputs[0];
+            for(int sample = 0; sample < numSamples; ++sample) output[sample] = first[sample];
+            for(int channel = 1; channel < numInputs; channel++) {
+                const float* __restrict in = inputs[channel];
+                for(int sample = 0; sample < numSamples; ++sample) output[sample] += in[sample];
+            }
+            for(int sample = 0; sample < numSamples; ++sample) output[sample] *= gain;
+        }
+
+        inline void count_abnormal_impl(const float* __restrict samples, int numSamples, int& denormals, int& nonFinite)
+        {
+            // integer tests on the bit patterns, a comparison of NaNs would be optimized away with -ffast-math
+            int numDenormals = 0, numNonFinite = 0;
+            for(int sample = 0; sample < numSamples; ++sample) {
+                uint32_t bits;
+                std::memcpy(&bits, samples + sample, sizeof(bits));
+                const uint32_t exponent = bits & 0x7f800000u;
+                numNonFinite += exponent == 0x7f800000u;
+                numDenormals += exponent == 0 && (bits & 0x007fffffu) != 0;
+            }
+            denormals += numDenormals;
+            nonFinite += numNonFinite;
+        }
+
+        #define REVERB_DEFINE_KERNELS(suffix, attributes) \
+            attributes void process_channel_##suffix(comb_filter* combs, int numCombs, allpass_filter* allpasses, int numAllpasses, const float* input, float* output, float* outputACN0, int numSamples, const channel_gains& gains, bool initACN0) \
+            { process_channel_impl(combs, numCombs, allpasses, numAllpasses, input, output, outputACN0, numSamples, gains, initACN0); } \
+            attributes void comb_bank_##suffix(comb_filter* combs, int numCombs, const float* input, float* output, int numSamples, float gain) \
+            { comb_bank_impl(combs, numCombs, input, output, numSamples, gain); } \
+            attributes void allpass_chain_##suffix(allpass_filter* allpasses, int numAllpasses, float* samples, int numSamples, float gain) \
+            { allpass_chain_impl(allpasses, numAllpasses, samples, numSamples, gain); } \
+            attributes void add_scaled_##suffix(const float* input, float* output, int numSamples, float gain) \
+            { add_scaled_impl(input, output, numSamples, gain); } \
+            attributes void mix_##suffix(const float* const* inputs, int numInputs, float* output, int numSamples, float gain) \
+            { mix_impl(inputs, numInputs, output, numSamples, gain); } \
+            attributes void count_abnormal_##suffix(const float* samples, int numSamples, int& denormals, int& nonFinite) \
+            { count_abnormal_impl(samples, numSamples, denormals, nonFinite); } \
+            const kernel_table kernels_##suffix = { #suffix, process_channel_##suffix, comb_bank_##suffix, allpass_chain_##suffix, add_scaled_##suffix, \
+                                                  mix_##suffix, count_abnormal_##suffix };
+
+        REVERB_DEFINE_KERNELS(generic, REVERB_KERNEL_GENERIC)
+
+       #if REVERB_X86_DISPATCH
+        REVERB_DEFINE_KERNELS(sse2, REVERB_KERNEL("sse2"))
+        REVERB_DEFINE_KERNELS(avx2, REVERB_KERNEL("avx2"))
+        REVERB_DEFINE_KERNELS(avx512, REVERB_KERNEL("avx512f,avx512vl,avx512bw,avx512dq"))
+       #endif
+    }
+
+    bool is_supported(instruction_set set)
+    {
+        switch (set) {
+            case instruction_set::generic:
+                return true;
+           #if REVERB_X86_DISPATCH
+            case instruction_set::sse2:
+                return __builtin_cpu_supports("sse2");
+            case instruction_set::avx2:
+                return __builtin_cpu_supports("avx2");
+            case instruction_set::avx512:
+                return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")
+                    && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq");
+           #endif
+            default:
+                return false;
+        }
+    }
+
+    instruction_set detect_instruction_set()
+    {
+       #if REVERB_X86_DISPATCH
+        __builtin_cpu_init();
+       #endif
+        for (auto set : {instruction_set::avx512, instruction_set::avx2, instruction_set::sse2}) {
+            if (is_supported(set)) return set;
+        }
+        return instruction_set::generic;
+    }
+
+    const kernel_table& get_kernels(instruction_set set)
+    {
+        switch (set) {
+           #if REVERB_X86_DISPATCH
+            case instruction_set::sse2:     return kernels_sse2;
+            case instruction_set::avx2:     return kernels_avx2;
+            case instruction_set::avx512:   return kernels_avx512;
+           #endif
+            default:                        return kernels_generic;
+        }
+    }
+}
@@ -0,0 +1,105 @@
+/**
+ * \file diffuse_kernels.h
+ *
+ * \brief Block processing kernels of the diffuse model with runtime instruction set dispatch.
+ *
+ * \details The kernels are compiled for several instruction sets (generic, SSE2, AVX2 and AVX-512 on x86) in one binary. diffuse_kernels::detect_instruction_set checks the CPU once and diffuse_kernels::get_kernels returns the table of the matching variant, the plugin does this in prepareToPlay. All variants give bit-identical results, they only differ in the instructions the compiler may use.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#ifndef diffuse_kernels_h
+#define diffuse_kernels_h
+
+#include "comb_filter.h"
+#include "allpass_filter.h"
+
+namespace diffuse_kernels
+{
+    /// instruction sets the kernels are compiled for
+    enum class instruction_set { generic, sse2, avx2, avx512 };
+
+    /// \brief Gains applied by diffuse_kernels::kernel_table::process_channel
+    struct channel_gains{
+        /// gain of the input signal feeding the comb_filter instances
+        float input;
+        /// wet gain times the SN3D normalization of the channel
+        float output;
+        /// gain of the channel output added to ACN0
+        float ACN0;
+        /// gain of the input signal in ACN0
+        float dry;
+    };
+
+    /// \brief Table of the kernels compiled for one instruction set
+    struct kernel_table{
+        /// name of the instruction set
+        const char* name;
+
+        /// \brief Runs the comb_filter bank, the allpass_filter chain and the output scaling of one channel in a single pass and adds the normalized output to ACN0
+        /// \param combs the numcombs comb_filter instances of the channel
+        /// \param numCombs the number of comb_filter instances that run, the first ones
+        /// \param allpasses the numallpasses allpass_filter instances of the channel
+        /// \param numAllpasses the number of allpass_filter instances that run, the first ones
+        /// \param input the mono input
+        /// \param output the output of the channel
+        /// \param outputACN0 the ACN0 output
+        /// \param numSamples the number of samples
+        /// \param gains the gains of the channel
+        /// \param initACN0 if true, ACN0 is initialized with the dry signal instead of being accumulated
+        void (*process_channel)(comb_filter* combs, int numCombs, allpass_filter* allpasses, int numAllpasses, const float* input, float* output, float* outputACN0, int numSamples, const channel_gains& gains, bool initACN0);
+
+        /// \brief Runs the comb_filter bank of one channel, the first stage of process_channel on its own
+        /// \param combs the numcombs comb_filter instances of the channel
+        /// \param numCombs the number of comb_filter instances that run, the first ones
+        /// \param input the mono input
+        /// \param output the sum of the comb_filter outputs
+        /// \param numSamples the number of samples
+        /// \param gain the gain of the input signal
+        void (*comb_bank)(comb_filter* combs, int numCombs, const float* input, float* output, int numSamples, float gain);
+
+        /// \brief Runs the allpass_filter chain of one channel in place and scales the output, the second stage of process_channel on its own
+        /// \param allpasses the numallpasses allpass_filter instances of the channel
+        /// \param numAllpasses the number of allpass_filter instances that run, the first ones
+        /// \param samples the output of comb_bank, replaced by the channel output
+        /// \param numSamples the number of samples
+        /// \param gain the wet gain times the SN3D normalization of the channel
+        void (*allpass_chain)(allpass_filter* allpasses, int numAllpasses, float* samples, int numSamples, float gain);
+
+        /// \brief Adds a scaled signal to another, used to sum the channels into ACN0
+        /// \param input the signal to add
+        /// \param output the sum
+        /// \param numSamples the number of samples
+        /// \param gain the gain of the added signal
+        void (*add_scaled)(const float* input, float* output, int numSamples, float gain);
+
+        /// \brief Mixes several signals to one
+        /// \param inputs the signals to mix
+        /// \param numInputs the number of signals
+        /// \param output the mixed signal (may not alias the inputs)
+        /// \param numSamples the number of samples
+        /// \param gain the gain applied to the sum
+        void (*mix)(const float* const* inputs, int numInputs, float* output, int numSamples, float gain);
+
+        /// \brief Counts the denormal and the not finite (NaN and infinite) samples of a signal
+        /// \param samples the signal
+        /// \param numSamples the number of samples
+        /// \param denormals incremented by the number of denormal samples
+        /// \param nonFinite incremented by the number of NaN and infinite samples
+        void (*count_abnormal)(const float* samples, int numSamples, int& denormals, int& nonFinite);
+    };
+
+    /// \brief Detects the best instruction set supported by the CPU and the operating system
+    instruction_set detect_instruction_set();
+
+    /// \brief Checks whether the kernels of an instruction set can run on this CPU
+    bool is_supported(instruction_set set);
+
+    /// \brief Gets the kernel table compiled for an instruction set
+    /// \param set the instruction set, must be supported by the CPU
+    const kernel_table& get_kernels(instruction_set set);
+}
+
+#endif /* diffuse_kernels_h */
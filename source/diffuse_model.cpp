@@ -0,0 +1,465 @@
+/**
+ * \file diffuse_model.cpp
+ *
+ * \brief Source for diffuse_model class
+ *
+ * \class diffuse_model
+ *
+ */
+
+#include "diffuse_model.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+    constexpr float halfPi = 1.57079632679489661923f;
+
+    /// \brief Sine fade in of a given length, sampled at the centers of the samples
+    void makeFade(std::vector<float>& fade, int length){
+        fade.resize((size_t) length);
+        for (size_t i = 0; i < fade.size(); i++)
+            fade[i] = std::sin(halfPi * ((float) i + 0.5f) / (float) fade.size());
+    }
+}
+
+diffuse_model::diffuse_model(){
+    kernels = &diffuse_kernels::get_kernels(diffuse_kernels::instruction_set::generic);
+    gain = initialgain;
+    feedback = (initialroom*scalefeedback) + offsetfeedback;
+    damp = initialdamp;
+    wet_factor = initialwet/numcombs;
+    dry = initialdry;
+    freezemode = initialfreeze;
+    newroom = initialroom;
+    oldroom = initialroom;
+}
+
+void diffuse_model::prepare(int numInputChannelsIn, int numOutputChannelsIn, double sampleRate, int maximumBlockSize){
+    numInputChannels = numInputChannelsIn;
+    numOutputChannels = numOutputChannelsIn;
+    const int numChannels = std::max(0, numOutputChannels-1);
+    inputBuffer.assign((size_t) std::max(1, maximumBlockSize), 0.f);
+
+    const float max_comb_buffactor = (1 + (scale_comb_buffer)-(scale_comb_buffer/2));
+    const float max_allpass_buffactor = (1 + (scale_allpass_buffer)-(scale_allpass_buffer/2));
+    comb.assign((size_t) numChannels, std::vector<comb_filter>(numcombs));
+    allpass.assign((size_t) numChannels, std::vector<allpass_filter>(numallpasses));
+    for (int i = 0; i < numChannels; i++){
+        for (int j = 0; j < numcombs; j++){
+            comb[i][j].initBuffer((int) ((i*spreadvalue) + (comb_buffer_tuning[j]*max_comb_buffactor)));
+        }
+        for (int j = 0; j < numallpasses; j++){
+            allpass[i][j].initBuffer((int) ((i*spreadvalue) + (allpass_buffer_tuning[j]*max_allpass_buffactor)));
+        }
+    }
+    activeCombs.assign((size_t) numChannels, numcombs);
+    activeAllpasses.assign((size_t) numChannels, numallpasses);
+    combCompensation.assign((size_t) numChannels, 1.f);
+    fadeCombs = activeCombs;
+    fadeAllpasses = activeAllpasses;
+    fadeCompensation = combCompensation;
+    ACN_normalization.assign((size_t) numOutputChannels, 0.f);
+    SN3D_normalization(numOutputChannels);
+
+    // the frozen tail is recorded in a loop buffer that the audio thread never allocates
+    freezeLoopLength = std::max(1, (int) (freeze_loop_length * sampleRate));
+    freezeLoop.assign((size_t) numChannels, std::vector<float>((size_t) freezeLoopLength, 0.f));
+    makeFade(freezeFade, std::clamp((int) (freeze_crossfade_length * sampleRate), 1, freezeLoopLength));
+    freezeSamples = 0;
+
+    makeFade(tierFade, std::max(1, (int) (quality_tier_fade_length * sampleRate)));
+    tierFadeBuffer.assign(processingTileSize, 0.f);
+    // the filters start muted, there is nothing to fade from
+    tierFadeRemaining = 0;
+
+    // the kernels compiled for the best instruction set of this CPU
+    kernels = &diffuse_kernels::get_kernels(diffuse_kernels::detect_instruction_set());
+
+    setdamp(damp);
+    setroomsize(newroom);
+    setfreezemode(freezemode);
+}
+
+void diffuse_model::setkernels(const diffuse_kernels::kernel_table& table){
+    kernels = &table;
+}
+
+const diffuse_kernels::kernel_table& diffuse_model::getkernels() const{
+    return *kernels;
+}
+
+int diffuse_model::getnumoutputchannels() const{
+    return numOutputChannels;
+}
+
+void diffuse_model::reset(){
+    if (newroom != oldroom) setroomsize(newroom);
+    for (auto& combs : comb){
+        for (auto& filter : combs) filter.reset();
+    }
+    for (auto& allpasses : allpass){
+        for (auto& filter : allpasses) filter.reset();
+    }
+    freezeSamples = 0;
+    tierFadeRemaining = 0;
+}
+
+void diffuse_model::mute(){
+    for (auto& combs : comb){
+        for (auto& filter : combs) filter.mute();
+    }
+    for (auto& allpasses : allpass){
+        for (auto& filter : allpasses) filter.mute();
+    }
+}
+
+void diffuse_model::setroomsize(float value){
+    feedback = (value*scalefeedback) + offsetfeedback;
+    const float comb_buffactor = 1 + (value*scale_comb_buffer)-(scale_comb_buffer/2);
+    const float allpass_buffactor = 1 + (value*scale_allpass_buffer)-(scale_allpass_buffer/2);
+
+    for (int i = 0; i < (int) comb.size(); i++){
+        for (int j = 0; j < numcombs; j++){
+            comb[i][j].setbuffer((int) ((i*spreadvalue) + comb_buffer_tuning[j]*comb_buffactor));
+            comb[i][j].setfeedback(feedback);
+        }
+        for (int j = 0; j < numallpasses; j++){
+            allpass[i][j].setbuffer((int) ((i*spreadvalue) + allpass_buffer_tuning[j]*allpass_buffactor));
+            allpass[i][j].setfeedback(feedback);
+        }
+    }
+    oldroom = value;
+}
+
+void diffuse_model::requestroomsize(float value){
+    newroom = value;
+}
+
+float diffuse_model::getroomsize() const{
+    return oldroom;
+}
+
+void diffuse_model::setdamp(float value){
+    if (value < 0.95f && value > 0.05f) {
+        damp = value;
+        for (auto& combs : comb){
+            for (auto& filter : combs) filter.setdamp(damp);
+        }
+    }
+}
+
+float diffuse_model::getdamp() const{
+    return damp;
+}
+
+void diffuse_model::setwet(float value){
+    wet_factor = value/numcombs;
+}
+
+float diffuse_model::getwet() const{
+    return wet_factor*numcombs;
+}
+
+void diffuse_model::setdry(float value){
+    dry = value;
+}
+
+float diffuse_model::getdry() const{
+    return dry;
+}
+
+void diffuse_model::setfreezemode(bool state){
+    freezemode = state;
+    float feedback_filters, damp_comb;
+
+    // Recalculate internal values after parameter change
+    if (freezemode){
+        feedback_filters = 1;
+        damp_comb = 0;
+        gain = 0;
+    }
+    else {
+        feedback_filters = feedback;
+        damp_comb = damp;
+        gain = initialgain;
+        mute();
+    }
+
+    for (auto& combs : comb){
+        for (auto& filter : combs){
+            filter.setfeedback(feedback_filters);
+            filter.setdamp(damp_comb);
+        }
+    }
+    for (auto& allpasses : allpass){
+        for (auto& filter : allpasses) filter.setfeedback(feedback_filters);
+    }
+}
+
+bool diffuse_model::getfreezemode() const{
+    return freezemode;
+}
+
+void diffuse_model::restartfreeze(){
+    if (freezemode) setfreezemode(true);
+    freezeSamples = 0;
+}
+
+bool diffuse_model::canapplyqualitytier() const{
+    return tierFadeRemaining == 0 && not freezemode;
+}
+
+void diffuse_model::applyqualitytier(int tier, const int* detailCombs, const int* detailAllpasses){
+    REVERB_TRACE_SCOPE("quality tier change");
+    tier = std::clamp(tier, 0, numqualitytiers-1);
+    for (int i = 0; i < (int) comb.size(); i++){
+        // ACN i+1 belongs to the order floor(sqrt(i+1))
+        int order = 1;
+        while ((order+1)*(order+1) <= i+1) order++;
+        const int combs = std::clamp(std::min(detailCombs[order-1], quality_tier_combs[tier][order-1]), 1, numcombs);
+        const int allpasses = std::clamp(detailAllpasses[order-1], 0, numallpasses);
+        // filters that run again start empty at the delay of the current room size, they did not follow the room size while
+        // they were dropped and would glide in pitch towards it
+        for (int j = activeCombs[i]; j < combs; j++){
+            comb[i][j].reset();
+        }
+        for (int j = activeAllpasses[i]; j < allpasses; j++){
+            allpass[i][j].reset();
+        }
+        if (combs != activeCombs[i] || allpasses != activeAllpasses[i]) tierFadeRemaining = (int) tierFade.size();
+        fadeCombs[i] = activeCombs[i];
+        fadeAllpasses[i] = activeAllpasses[i];
+        fadeCompensation[i] = combCompensation[i];
+        activeCombs[i] = combs;
+        activeAllpasses[i] = allpasses;
+        combCompensation[i] = std::sqrt((float) numcombs / (float) combs);
+    }
+}
+
+void diffuse_model::downmix(const float* const* inputs, int numSamples){
+    // mono downmix of all inputs, scaled once while mixing
+    REVERB_TRACE_SCOPE("input downmix");
+    kernels->mix(inputs, numInputChannels, inputBuffer.data(), numSamples,
+                 numInputChannels > 0 ? 1.f/(float) numInputChannels : 0.f);
+}
+
+void diffuse_model::process(float* const* outputs, int numSamples){
+    if (freezemode) processFrozen(outputs, numSamples);
+    else if (tierFadeRemaining > 0) processTierFade(outputs, numSamples);
+    else processTiles(outputs, numSamples);
+}
+
+void diffuse_model::processTiles(float* const* outputs, int numSamples){
+    REVERB_TRACE_SCOPE("diffuse model");
+    const float* readinPointer = inputBuffer.data();
+    float* writePointerACN0 = outputs[0];
+
+    // Every output sample is written exactly once below, so the buffer does not need to be cleared.
+    // The block is processed in tiles, so that the input and ACN0 slices stay in cache while all channels run over them.
+    for(int tileStart = 0; tileStart < numSamples; tileStart += processingTileSize)
+    {
+        const int tileSize = std::min(processingTileSize, numSamples - tileStart);
+
+        if (numOutputChannels < 2) {
+            const float* tileInput = readinPointer + tileStart;
+            kernels->mix(&tileInput, 1, writePointerACN0 + tileStart, tileSize, dry * ACN_normalization[0]);
+        }
+
+        for(int channel=1; channel<numOutputChannels; channel++)
+        {
+            const diffuse_kernels::channel_gains gains = {gain, wet_factor * ACN_normalization[channel] * combCompensation[channel-1], 1.f / sum_ACN_normalization, dry * ACN_normalization[0]};
+            kernels->process_channel(comb[channel-1].data(), activeCombs[channel-1], allpass[channel-1].data(), activeAllpasses[channel-1], readinPointer + tileStart, outputs[channel] + tileStart,
+                                     writePointerACN0 + tileStart, tileSize, gains, channel == 1);
+        }
+    }
+}
+
+void diffuse_model::processstages(float* const* outputs, int numSamples, perf_counters* counters){
+    if (not canprocesschannels()) {
+        process(outputs, numSamples);
+        return;
+    }
+
+    // The same operations in the same order as the tiled processing, so the output does not change.
+    // The comb_filter outputs are kept in the channel buffers until the allpass_filter chain runs over them.
+    REVERB_TRACE_SCOPE("diffuse model stages");
+    const float* readinPointer = inputBuffer.data();
+
+    for(int channel=1; channel<numOutputChannels; channel++)
+        kernels->comb_bank(comb[channel-1].data(), activeCombs[channel-1], readinPointer, outputs[channel], numSamples, gain);
+    if (counters != nullptr) counters->end_stage(perf_counters::comb_bank);
+
+    for(int channel=1; channel<numOutputChannels; channel++)
+        kernels->allpass_chain(allpass[channel-1].data(), activeAllpasses[channel-1], outputs[channel], numSamples, wet_factor * ACN_normalization[channel] * combCompensation[channel-1]);
+    if (counters != nullptr) counters->end_stage(perf_counters::allpass_chain);
+
+    mixchannels(outputs, numSamples);
+    if (counters != nullptr) counters->end_stage(perf_counters::mixing);
+}
+
+bool diffuse_model::canprocesschannels() const{
+    return not freezemode && tierFadeRemaining == 0;
+}
+
+void diffuse_model::processchannel(int channel, float* output, int numSamples){
+    kernels->comb_bank(comb[channel-1].data(), activeCombs[channel-1], inputBuffer.data(), output, numSamples, gain);
+    kernels->allpass_chain(allpass[channel-1].data(), activeAllpasses[channel-1], output, numSamples, wet_factor * ACN_normalization[channel] * combCompensation[channel-1]);
+}
+
+void diffuse_model::mixchannels(float* const* outputs, int numSamples){
+    const float* readinPointer = inputBuffer.data();
+    float* writePointerACN0 = outputs[0];
+    kernels->mix(&readinPointer, 1, writePointerACN0, numSamples, dry * ACN_normalization[0]);
+    for(int channel=1; channel<numOutputChannels; channel++)
+        kernels->add_scaled(outputs[channel], writePointerACN0, numSamples, 1.f / sum_ACN_normalization);
+}
+
+bool diffuse_model::finishblock(){
+    // The new room size is taken over once all delay lines finished the previous resize.
+    // Nothing here may allocate, lock or print, it runs on the audio thread.
+    bool ready = true;
+    for (int i = 0; i < (int) comb.size() && ready; i++){
+        // dropped filters do not move, they take over the room size at once when they run again
+        for (int j = 0; j < activeCombs[i]; j++){
+            if (not comb[i][j].ready()) ready = false;
+        }
+        for (int j = 0; j < activeAllpasses[i]; j++){
+            if (not allpass[i][j].ready()) ready = false;
+        }
+    }
+    // A frozen tail keeps the room size it was frozen with, the delay lines are idle while the loop plays.
+    if (not freezemode) freezeSamples = 0;
+    if (ready == true && newroom != oldroom && not freezemode) {
+        REVERB_TRACE_SCOPE("room size change");
+        setroomsize(newroom);
+        ready = false;
+    }
+    return not ready;
+}
+
+comb_filter& diffuse_model::getcomb(int channel, int index){
+    return comb[channel-1][index];
+}
+
+allpass_filter& diffuse_model::getallpass(int channel, int index){
+    return allpass[channel-1][index];
+}
+
+void diffuse_model::processFrozen(float* const* outputs, int numSamples){
+    // The loop is recorded while the diffuse model runs with unity feedback. For the last freezeFade.size() samples the
+    // recording is crossfaded into the start of the loop, so reading on from there continues without a jump.
+    REVERB_TRACE_SCOPE("frozen loop");
+    // a tier change that is still fading ends here, the loop is recorded with the new filters
+    tierFadeRemaining = 0;
+    const float* readinPointer = inputBuffer.data();
+    const int fadeLength = (int) freezeFade.size();
+    const int recordingLength = freezeLoopLength + fadeLength;
+    const int recordedSamples = std::min(numSamples, std::max(0, recordingLength - freezeSamples));
+
+    for(int channel=1; channel<numOutputChannels; channel++)
+    {
+        float* output = outputs[channel];
+        float* loop = freezeLoop[channel-1].data();
+
+        if (recordedSamples > 0) {
+            kernels->comb_bank(comb[channel-1].data(), activeCombs[channel-1], readinPointer, output, recordedSamples, gain);
+            kernels->allpass_chain(allpass[channel-1].data(), activeAllpasses[channel-1], output, recordedSamples, combCompensation[channel-1]);
+            for (int i = 0; i < recordedSamples; i++){
+                const int position = freezeSamples + i;
+                if (position < freezeLoopLength) {
+                    loop[position] = output[i];
+                }
+                else {
+                    const int fade = position - freezeLoopLength;
+                    output[i] = output[i] * freezeFade[(size_t) (fadeLength - 1 - fade)] + loop[fade] * freezeFade[(size_t) fade];
+                    loop[fade] = output[i];
+                }
+            }
+        }
+
+        // playback goes on behind the crossfade
+        int position = (freezeSamples + recordedSamples - freezeLoopLength) % freezeLoopLength;
+        for (int i = recordedSamples; i < numSamples;){
+            const int length = std::min(numSamples - i, freezeLoopLength - position);
+            std::copy(loop + position, loop + position + length, output + i);
+            position = 0;
+            i += length;
+        }
+        const float outputGain = wet_factor * ACN_normalization[channel];
+        for (int i = 0; i < numSamples; i++) output[i] *= outputGain;
+    }
+
+    freezeSamples += numSamples;
+    // kept within one loop length behind the recording, so that it cannot overflow
+    if (freezeSamples >= recordingLength + freezeLoopLength) freezeSamples -= freezeLoopLength;
+
+    mixchannels(outputs, numSamples);
+}
+
+void diffuse_model::processTierFade(float* const* outputs, int numSamples){
+    // The filters that applyqualitytier dropped or runs again are summed apart from the others and faded out or in, the
+    // allpass_filter chain is crossfaded between its output without and with them, and the gain that makes up for the
+    // dropped combs glides from its previous value, so that a tier change does not click.
+    REVERB_TRACE_SCOPE("quality tier fade");
+    const float* readinPointer = inputBuffer.data();
+    float* changed = tierFadeBuffer.data();
+    const int fadeLength = (int) tierFade.size();
+    const int fadeStart = fadeLength - tierFadeRemaining;
+    auto fadeIn = [&] (int sample) { return fadeStart + sample < fadeLength ? tierFade[(size_t) (fadeStart + sample)] : 1.f; };
+    auto fadeOut = [&] (int sample) { return fadeStart + sample < fadeLength ? tierFade[(size_t) (fadeLength - 1 - fadeStart - sample)] : 0.f; };
+
+    for(int channel=1; channel<numOutputChannels; channel++)
+    {
+        const int i = channel-1;
+        const int keptCombs = std::min(fadeCombs[i], activeCombs[i]);
+        const int changedCombs = std::abs(activeCombs[i] - fadeCombs[i]);
+        const int keptAllpasses = std::min(fadeAllpasses[i], activeAllpasses[i]);
+        const int changedAllpasses = std::abs(activeAllpasses[i] - fadeAllpasses[i]);
+        const float outputGain = wet_factor * ACN_normalization[channel];
+
+        for(int tileStart = 0; tileStart < numSamples; tileStart += processingTileSize)
+        {
+            const int tileSize = std::min(processingTileSize, numSamples - tileStart);
+            float* output = outputs[channel] + tileStart;
+
+            kernels->comb_bank(comb[i].data(), keptCombs, readinPointer + tileStart, output, tileSize, gain);
+            if (changedCombs > 0) {
+                kernels->comb_bank(comb[i].data() + keptCombs, changedCombs, readinPointer + tileStart, changed, tileSize, gain);
+                for (int sample = 0; sample < tileSize; sample++)
+                    output[sample] += changed[sample] * (activeCombs[i] > fadeCombs[i] ? fadeIn(tileStart + sample) : fadeOut(tileStart + sample));
+            }
+
+            kernels->allpass_chain(allpass[i].data(), keptAllpasses, output, tileSize, 1.f);
+            if (changedAllpasses > 0) {
+                std::copy(output, output + tileSize, changed);
+                kernels->allpass_chain(allpass[i].data() + keptAllpasses, changedAllpasses, changed, tileSize, 1.f);
+                for (int sample = 0; sample < tileSize; sample++)
+                    output[sample] += (changed[sample] - output[sample]) * (activeAllpasses[i] > fadeAllpasses[i] ? fadeIn(tileStart + sample) : fadeOut(tileStart + sample));
+            }
+
+            for (int sample = 0; sample < tileSize; sample++)
+                output[sample] *= outputGain * (fadeCompensation[i] + (combCompensation[i] - fadeCompensation[i]) * fadeIn(tileStart + sample));
+        }
+    }
+    tierFadeRemaining = std::max(0, tierFadeRemaining - numSamples);
+
+    mixchannels(outputs, numSamples);
+}
+
+void diffuse_model::SN3D_normalization(int channelnum){
+    sum_ACN_normalization = 0.f;
+    for (int i = 0; i < channelnum; i++){
+        // ACN i = l*l + l + m, the factor is sqrt((2 - delta_m0) * (l-|m|)! / (l+|m|)!) for all orders up to 7
+        const int l = (int) std::sqrt((double) i);
+        const int m = std::abs(i - l*l - l);
+        double ratio = 1.0;
+        for (int k = l - m + 1; k <= l + m; k++) ratio /= k;
+        ACN_normalization[i] = (float) std::sqrt((m == 0 ? 1.0 : 2.0) * ratio);
+
+        sum_ACN_normalization += ACN_normalization[i];
+    }
+}
@@ -0,0 +1,219 @@
+/**
+ * \file diffuse_model.h
+ *
+ * \brief The diffuse model of the plugin: the comb_filter and allpass_filter network of every ambisonic channel with its parameters, the freeze loop and the fades of quality tier changes.
+ *
+ * \details AudioPluginAudioProcessor owns one diffuse_model and adds the host interface, the snapshots, the quality_governor and the telemetry around it. The model does not depend on JUCE, so the golden check (bench/golden_render.cpp) renders its scenarios through the same code the plugin runs. A block is processed by diffuse_model::downmix followed by diffuse_model::process (or diffuse_model::processstages, or diffuse_model::processchannel and diffuse_model::mixchannels for offline rendering) and diffuse_model::finishblock. Apart from diffuse_model::prepare every method is real-time safe, and all of them must be called by the audio thread or while it does not process.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#ifndef diffuse_model_h
+#define diffuse_model_h
+
+#include <vector>
+#include "comb_filter.h"
+#include "allpass_filter.h"
+#include "diffuse_kernels.h"
+#include "perf_counters.h"
+#include "tuning.h"
+
+class diffuse_model{
+public:
+    diffuse_model();
+
+    /// \brief diffuse_model::prepare Allocates the filters, the freeze loop and the buffers for a channel configuration, not real-time safe
+    /// \details The filters are set up with the current parameters, the kernels of the best instruction set of the CPU are selected and all channels run the full number of filters.
+    /// \param numInputChannels the number of input channels mixed down to the mono input
+    /// \param numOutputChannels the number of ambisonic output channels, ACN0 to ACN numOutputChannels-1
+    /// \param sampleRate the sample rate
+    /// \param maximumBlockSize the most samples a block may have
+    void prepare(int numInputChannels, int numOutputChannels, double sampleRate, int maximumBlockSize);
+
+    /// \brief diffuse_model::setkernels Selects the kernels the model is processed with
+    /// \param table the kernels of an instruction set the CPU supports
+    void setkernels(const diffuse_kernels::kernel_table& table);
+
+    /// \brief diffuse_model::getkernels Gets the kernels the model is processed with
+    /// \return the kernel table [const diffuse_kernels::kernel_table&]
+    const diffuse_kernels::kernel_table& getkernels() const;
+
+    /// \brief diffuse_model::getnumoutputchannels Gets the number of output channels set up by diffuse_model::prepare
+    /// \return the number of output channels [int]
+    int getnumoutputchannels() const;
+
+    /// \brief diffuse_model::reset Clears the filters without reallocating them, a pending room size is taken over at once instead of resizing the delay lines
+    void reset();
+
+    /// \brief diffuse_model::mute Mutes all buffers within the allpass_filter and comb_filter instances
+    void mute();
+
+    /// \brief diffuse_model::setroomsize Sets the roomsize at once
+    /// \details This function calculates buffer sizes for the allpass_filter and comb_filter instances and passes those new buffer sizes to the allpass_filter::setbuffer and comb_filter::setbuffer functions. Also a new feedback value for the comb_filters is calculated and passed via the comb_filter::setfeedback function.
+    /// \param value The desired roomsize value on which the allpass_filter and comb_filter buffer sizes depend as well as the comb_filter feedback value
+    void setroomsize(float value);
+
+    /// \brief diffuse_model::requestroomsize Sets the roomsize diffuse_model::finishblock takes over once the delay lines finished the running resize
+    /// \param value the desired roomsize value
+    void requestroomsize(float value);
+
+    /// \brief diffuse_model::getroomsize Gets the roomsize the delay lines were last set to
+    /// \return the roomsize value [float]
+    float getroomsize() const;
+
+    /// \brief diffuse_model::setdamp Sets the dampening factor for the comb_filter instances
+    /// \param value the desired dampening value, only values between 0.05 and 0.95 are taken over
+    void setdamp(float value);
+
+    /// \brief diffuse_model::getdamp Gets the dampening value for the comb_filter instances
+    /// \return the current dampening value [float]
+    float getdamp() const;
+
+    /// \brief diffuse_model::setwet Sets the wet amount in signal output
+    /// \param value The desired wet value [float]
+    void setwet(float value);
+
+    /// \brief diffuse_model::getwet Gets the wet amount in signal output
+    /// \return The wet value [float]
+    float getwet() const;
+
+    /// \brief diffuse_model::setdry Sets the dry amount in signal output
+    /// \param value The desired dry value [float]
+    void setdry(float value);
+
+    /// \brief diffuse_model::getdry Gets the dry amount in signal output
+    /// \return The dry value [float]
+    float getdry() const;
+
+    /// \brief diffuse_model::setfreezemode Sets the freeze option on and off
+    /// \details The diffuse model recirculates without input until it has recorded freeze_loop_length plus freeze_crossfade_length seconds of every channel, then the tail is played from the loop and the comb_filter and allpass_filter instances are idle until the freeze ends.
+    /// \param state The desired state value [bool]
+    void setfreezemode(bool state);
+
+    /// \brief diffuse_model::getfreezemode Gets the freeze mode state
+    /// \return The freezemode state value [bool]
+    bool getfreezemode() const;
+
+    /// \brief diffuse_model::restartfreeze Records the frozen tail again, after the delay lines were replaced by a snapshot
+    void restartfreeze();
+
+    /// \brief diffuse_model::canapplyqualitytier Checks whether diffuse_model::applyqualitytier may be called
+    /// \details A change waits for the fade of the previous one. While frozen, the filters are left alone, a step would be recorded into the loop.
+    /// \return true if no tier change is fading and the model is not frozen [bool]
+    bool canapplyqualitytier() const;
+
+    /// \brief diffuse_model::applyqualitytier Sets the number of comb_filter and allpass_filter instances of every channel from a detail profile and a quality tier
+    /// \details Filters that run again are cleared and start at the delay of the current room size, the others keep their state. The wet gain of a channel is raised by the square root of the dropped fraction of its combs, so that the level of the tail stays the same. diffuse_model::process fades from the previous filters to the new ones over quality_tier_fade_length.
+    /// \param tier the quality tier, see quality_tier_combs in tuning.h
+    /// \param detailCombs the comb_filter instances per channel of the orders 1 to 7
+    /// \param detailAllpasses the allpass_filter instances per channel of the orders 1 to 7
+    void applyqualitytier(int tier, const int* detailCombs, const int* detailAllpasses);
+
+    /// \brief diffuse_model::downmix Mixes the inputs of a block down to the mono input of the model, the first step of every block
+    /// \param inputs the numInputChannels input channels
+    /// \param numSamples the number of samples, at most the maximum block size given to diffuse_model::prepare
+    void downmix(const float* const* inputs, int numSamples);
+
+    /// \brief diffuse_model::process Processes the mono input into all output channels
+    /// \details The block is processed in tiles, so that the input and ACN0 slices stay in cache while all channels run over them. Every output sample is written, the outputs may alias the inputs given to diffuse_model::downmix.
+    /// \param outputs the numOutputChannels output channels
+    /// \param numSamples the number of samples given to diffuse_model::downmix
+    void process(float* const* outputs, int numSamples);
+
+    /// \brief diffuse_model::processstages Processes like diffuse_model::process, but runs the comb_filter bank, the allpass_filter chain and the mixing of all channels one after the other
+    /// \details The output is the same as the one of diffuse_model::process. While frozen or while a tier change fades the block is processed by diffuse_model::process and no stage is counted.
+    /// \param outputs the numOutputChannels output channels
+    /// \param numSamples the number of samples given to diffuse_model::downmix
+    /// \param counters receives the end of every stage, may be nullptr
+    void processstages(float* const* outputs, int numSamples, perf_counters* counters);
+
+    /// \brief diffuse_model::canprocesschannels Checks whether the channels of the next block may be processed by diffuse_model::processchannel
+    /// \return false while frozen or while a tier change fades, the block then has to be processed by diffuse_model::process [bool]
+    bool canprocesschannels() const;
+
+    /// \brief diffuse_model::processchannel Runs the comb_filter bank and the allpass_filter chain of one channel, the channels are independent and may run on different threads
+    /// \param channel the ACN channel, 1 to numOutputChannels-1
+    /// \param output the output of the channel
+    /// \param numSamples the number of samples given to diffuse_model::downmix
+    void processchannel(int channel, float* output, int numSamples);
+
+    /// \brief diffuse_model::mixchannels Writes ACN0 from the dry input and the outputs of diffuse_model::processchannel, summed in channel order like diffuse_model::process does
+    /// \param outputs the numOutputChannels output channels
+    /// \param numSamples the number of samples given to diffuse_model::downmix
+    void mixchannels(float* const* outputs, int numSamples);
+
+    /// \brief diffuse_model::finishblock Takes over a room size set by diffuse_model::requestroomsize once the delay lines are ready, the last step of every block
+    /// \return true while a resize is in progress [bool]
+    bool finishblock();
+
+    /// \brief diffuse_model::getcomb Gets a comb_filter instance, for the snapshots
+    /// \param channel the ACN channel, 1 to numOutputChannels-1
+    /// \param index the comb_filter of the channel, 0 to numcombs-1
+    comb_filter& getcomb(int channel, int index);
+
+    /// \brief diffuse_model::getallpass Gets an allpass_filter instance, for the snapshots
+    /// \param channel the ACN channel, 1 to numOutputChannels-1
+    /// \param index the allpass_filter of the channel, 0 to numallpasses-1
+    allpass_filter& getallpass(int channel, int index);
+
+private:
+    /// number of samples processed per channel before moving on to the next channel
+    constexpr static int processingTileSize = 256;
+
+    /// \brief diffuse_model::processTiles Processes the channels tile by tile with the fused kernel
+    void processTiles(float* const* outputs, int numSamples);
+    /// \brief diffuse_model::processFrozen Records the frozen tail into the freeze loop and plays it back once it is complete
+    void processFrozen(float* const* outputs, int numSamples);
+    /// \brief diffuse_model::processTierFade Runs the diffuse model while the filters dropped or run again by diffuse_model::applyqualitytier fade out or in
+    void processTierFade(float* const* outputs, int numSamples);
+    /// \brief diffuse_model::SN3D_normalization Calculates the normalization factors for the ambisonics channels based on the SN3D/ambiX standard
+    /// \param channelnum The number of channels
+    void SN3D_normalization(int channelnum);
+
+    /// kernels selected for the CPU in prepare
+    const diffuse_kernels::kernel_table* kernels;
+
+    std::vector<std::vector<comb_filter>> comb;
+    std::vector<std::vector<allpass_filter>> allpass;
+
+    /// the mono downmix of the inputs
+    std::vector<float> inputBuffer;
+    /// the frozen tail of every channel but ACN0, without the wet and normalization gains
+    std::vector<std::vector<float>> freezeLoop;
+    /// fade in of the crossfade into the loop, played backwards as the fade out
+    std::vector<float> freezeFade;
+    int freezeLoopLength = 0;
+    /// samples since the freeze started, freezeLoopLength + freezeFade.size() or more once the loop is played
+    int freezeSamples = 0;
+    /// comb_filter and allpass_filter instances that run per channel and the gain that makes up for the dropped combs
+    std::vector<int> activeCombs;
+    std::vector<int> activeAllpasses;
+    std::vector<float> combCompensation;
+    /// the same before the last applyqualitytier, processTierFade fades from them
+    std::vector<int> fadeCombs;
+    std::vector<int> fadeAllpasses;
+    std::vector<float> fadeCompensation;
+    /// fade in of the filters that run again, played backwards as the fade out of the dropped ones
+    std::vector<float> tierFade;
+    /// samples of the fade still to process, 0 if no tier change is fading
+    int tierFadeRemaining = 0;
+    /// output of the faded filters of one tile
+    std::vector<float> tierFadeBuffer;
+
+    float    gain;
+    float    feedback;
+    float    damp;
+    float    wet_factor;
+    float    dry;
+    bool     freezemode;
+    float    newroom;
+    float    oldroom;
+    int      numInputChannels = 0;
+    int      numOutputChannels = 0;
+    std::vector<float> ACN_normalization;
+    float    sum_ACN_normalization = 0.f;
+};
+
+#endif /* diffuse_model_h */
@@ -0,0 +1,166 @@
+/**
+ * \file interpolation.h
+ *
+ * \brief Fractional delay interpolation policies for the comb_filter and allpass_filter instances.
+ *
+ * \details A delay line only reads between two samples while it is resized. Then the read position moves with half speed (growing, buffer_step 0.5) or with double speed (shrinking, buffer_step 2). The policies defined here decide how these reads are done. In steady state the filters read a single sample and the policy is only told about it via track(), which is empty for all stateless policies, so a better policy does not cost anything outside of resizes.
+ *
+ * All policies read from a power-of-two ring buffer. position is the index of the sample at the integer part of the delay and alpha the fractional part, larger alpha means older. Samples at position + k are newer, samples at position - k older. The number of newer and older samples a policy needs is given by newer_taps and older_taps, the delay lines reserve room for them.
+ *
+ * The policy used by the plugin is chosen at compile time with the REVERB_DELAY_INTERPOLATION definition (none_interpolation, linear_interpolation, hermite_interpolation, thiran_interpolation or sinc_interpolation), linear_interpolation is the default.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#ifndef interpolation_h
+#define interpolation_h
+
+#include <cmath>
+
+/// \brief Reads the sample at the integer part of the delay (truncation)
+struct none_interpolation{
+    static constexpr int newer_taps = 0;
+    static constexpr int older_taps = 0;
+
+    template <typename Storage>
+    inline float read(const typename Storage::sample_type* buffer, unsigned long, unsigned long position, float, float){
+        return Storage::decode(buffer[position]);
+    }
+
+    inline void track(float) {}
+};
+
+/// \brief Linear interpolation between two samples, averages two samples while shrinking
+struct linear_interpolation{
+    static constexpr int newer_taps = 1;
+    static constexpr int older_taps = 1;
+
+    template <typename Storage>
+    inline float read(const typename Storage::sample_type* buffer, unsigned long mask, unsigned long position, float alpha, float buffer_step){
+        const float sample_1 = Storage::decode(buffer[position]);
+        if (buffer_step <= 1.f) return (1-alpha) * sample_1 + alpha * Storage::decode(buffer[(position - 1) & mask]);
+        return 0.5f * (sample_1 + Storage::decode(buffer[(position + 1) & mask]));
+    }
+
+    inline void track(float) {}
+};
+
+/// \brief 4-point cubic Hermite (Catmull-Rom) interpolation, smooths with a 4-point binomial kernel while shrinking
+struct hermite_interpolation{
+    static constexpr int newer_taps = 2;
+    static constexpr int older_taps = 2;
+
+    template <typename Storage>
+    inline float read(const typename Storage::sample_type* buffer, unsigned long mask, unsigned long position, float alpha, float buffer_step){
+        float y[4];
+        for (int k = 0; k < 4; k++) y[k] = Storage::decode(buffer[(position + 1 - k) & mask]);
+
+        if (buffer_step > 1.f){
+            // one newer sample more, so the kernel is centered between the sample and the next newer one like the read position
+            const float newer = Storage::decode(buffer[(position + 2) & mask]);
+            return 0.125f * (newer + 3.f * y[0] + 3.f * y[1] + y[2]);
+        }
+
+        const float c1 = 0.5f * (y[2] - y[0]);
+        const float c2 = y[0] - 2.5f * y[1] + 2.f * y[2] - 0.5f * y[3];
+        const float c3 = 0.5f * (y[3] - y[0]) + 1.5f * (y[1] - y[2]);
+        return ((c3 * alpha + c2) * alpha + c1) * alpha + y[1];
+    }
+
+    inline void track(float) {}
+};
+
+/// \brief First order allpass (Thiran) interpolation, averages two samples while shrinking
+/// \details The allpass keeps the magnitude response flat, which keeps the high frequencies of a growing delay line. Its coefficient is kept in the well-conditioned range by using a fractional delay between 0.5 and 1.5. The previous output is the state of the interpolator, in steady state it follows the samples read by the filter.
+struct thiran_interpolation{
+    static constexpr int newer_taps = 1;
+    static constexpr int older_taps = 1;
+
+    template <typename Storage>
+    inline float read(const typename Storage::sample_type* buffer, unsigned long mask, unsigned long position, float alpha, float buffer_step){
+        if (buffer_step > 1.f){
+            previous_output = 0.5f * (Storage::decode(buffer[position]) + Storage::decode(buffer[(position + 1) & mask]));
+            return previous_output;
+        }
+        float fraction = alpha;
+        if (alpha < 0.5f){
+            position = (position + 1) & mask;
+            fraction += 1.f;
+        }
+        const float eta = (1.f - fraction) / (1.f + fraction);
+        previous_output = eta * (Storage::decode(buffer[position]) - previous_output) + Storage::decode(buffer[(position - 1) & mask]);
+        return previous_output;
+    }
+
+    inline void track(float sample) { previous_output = sample; }
+
+private:
+    float previous_output = 0.f;
+};
+
+/// \brief 8-point Blackman windowed sinc interpolation
+/// \details The coefficients are read from a table of 128 fractional positions with linear interpolation in between. While shrinking the cutoff is halved, so that reading with double speed does not alias.
+struct sinc_interpolation{
+    static constexpr int newer_taps = 3;
+    static constexpr int older_taps = 4;
+    static constexpr int taps = newer_taps + older_taps + 1;
+    static constexpr int phases = 128;
+
+    /// \brief Coefficient table for one cutoff frequency, the last phase is the first one shifted by a sample
+    struct table{
+        float coefficients[phases + 1][taps];
+
+        explicit table(float cutoff){
+            const double pi = 3.14159265358979323846;
+            for (int phase = 0; phase <= phases; phase++){
+                const double alpha = (double) phase / phases;
+                double sum = 0.0;
+                for (int k = 0; k < taps; k++){
+                    // distance of tap k (delay position - newer_taps + k) to the read position
+                    const double t = (double) (k - newer_taps) - alpha;
+                    const double x = pi * cutoff * t;
+                    const double sinc = x == 0.0 ? 1.0 : std::sin(x) / x;
+                    const double w = (t + taps / 2.0) / taps;
+                    const double window = (w <= 0.0 || w >= 1.0) ? 0.0 : 0.42 - 0.5 * std::cos(2 * pi * w) + 0.08 * std::cos(4 * pi * w);
+                    coefficients[phase][k] = (float) (sinc * window);
+                    sum += sinc * window;
+                }
+                // unity gain at DC
+                for (int k = 0; k < taps; k++) coefficients[phase][k] = (float) (coefficients[phase][k] / sum);
+            }
+        }
+    };
+
+    template <typename Storage>
+    inline float read(const typename Storage::sample_type* buffer, unsigned long mask, unsigned long position, float alpha, float buffer_step){
+        const table& coefficients = buffer_step > 1.f ? halfband : fullband;
+        const float phase = alpha * phases;
+        const int index = (int) phase;
+        const float fraction = phase - (float) index;
+        const float* c0 = coefficients.coefficients[index];
+        const float* c1 = coefficients.coefficients[index + 1];
+
+        float samples[taps];
+        for (int k = 0; k < taps; k++) samples[k] = Storage::decode(buffer[(position + newer_taps - k) & mask]);
+
+        float output = 0.f;
+        for (int k = 0; k < taps; k++) output += (c0[k] + fraction * (c1[k] - c0[k])) * samples[k];
+        return output;
+    }
+
+    inline void track(float) {}
+
+    static inline const table fullband{1.f};
+    static inline const table halfband{0.5f};
+};
+
+#ifndef REVERB_DELAY_INTERPOLATION
+    #define REVERB_DELAY_INTERPOLATION linear_interpolation
+#endif
+
+/// fractional delay interpolation used by the plugin
+using delay_interpolation = REVERB_DELAY_INTERPOLATION;
+
+#endif /* interpolation_h */
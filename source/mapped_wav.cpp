@@ -0,0 +1,334 @@
+/**
+ * \file mapped_wav.cpp
+ *
+ * \brief Source for the memory mapped WAV files
+ *
+ * \details The samples are converted like the JUCE audio formats do, integers are scaled by the inverse of 2^(bits-1) when reading and by 2^(bits-1) with rounding and clipping to the symmetric range when writing, so both paths of reverb-render write the same files.
+ *
+ */
+
+#include "mapped_wav.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mapped_wav
+{
+    namespace
+    {
+        /// pages are given back to the kernel in steps of this many bytes
+        constexpr size_t release_step = 16 << 20;
+        constexpr uint16_t format_pcm = 1;
+        constexpr uint16_t format_float = 3;
+        constexpr uint16_t format_extensible = 0xFFFE;
+
+        uint16_t read16(const unsigned char* p) { return (uint16_t) (p[0] | (p[1] << 8)); }
+        uint32_t read32(const unsigned char* p) { return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24); }
+        uint64_t read64(const unsigned char* p) { return (uint64_t) read32(p) | ((uint64_t) read32(p + 4) << 32); }
+
+        unsigned char* write16(unsigned char* p, uint16_t v) { p[0] = (unsigned char) v; p[1] = (unsigned char) (v >> 8); return p + 2; }
+        unsigned char* write32(unsigned char* p, uint32_t v) { write16(p, (uint16_t) v); write16(p + 2, (uint16_t) (v >> 16)); return p + 4; }
+        unsigned char* write64(unsigned char* p, uint64_t v) { write32(p, (uint32_t) v); write32(p + 4, (uint32_t) (v >> 32)); return p + 8; }
+        unsigned char* write_id(unsigned char* p, const char* id) { std::memcpy(p, id, 4); return p + 4; }
+
+        size_t page_size(){
+            static const size_t size = (size_t) sysconf(_SC_PAGESIZE);
+            return size;
+        }
+
+        int32_t to_int(float sample, int bits){
+            const double scale = (double) (1u << (bits - 1));
+            const double limit = scale - 1.0;
+            return (int32_t) std::lround(std::clamp((double) sample * scale, -limit, limit));
+        }
+    }
+
+    bool is_supported() { return true; }
+
+    reader::~reader(){
+        close();
+    }
+
+    bool reader::open(const char* path, std::string& error){
+        close();
+        const int file = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (file < 0){
+            error = "could not open the file";
+            return false;
+        }
+        struct stat status;
+        if (fstat(file, &status) != 0 || status.st_size < 12){
+            ::close(file);
+            error = "not a WAV file";
+            return false;
+        }
+        mapped_size = (size_t) status.st_size;
+        void* mapping = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, file, 0);
+        // the mapping keeps the file open
+        ::close(file);
+        if (mapping == MAP_FAILED){
+            mapped_size = 0;
+            error = "could not map the file";
+            return false;
+        }
+        data = (const unsigned char*) mapping;
+
+        const bool rf64 = std::memcmp(data, "RF64", 4) == 0 || std::memcmp(data, "BW64", 4) == 0;
+        if ((std::memcmp(data, "RIFF", 4) != 0 && ! rf64) || std::memcmp(data + 8, "WAVE", 4) != 0){
+            close();
+            error = "not a WAV file";
+            return false;
+        }
+
+        uint64_t dataSize = 0;
+        uint16_t format = 0, bits = 0;
+        bool hasFormat = false;
+        size_t position = 12;
+        while (position + 8 <= mapped_size){
+            const unsigned char* chunk = data + position;
+            uint64_t size = read32(chunk + 4);
+            if (std::memcmp(chunk, "ds64", 4) == 0 && size >= 24){
+                dataSize = read64(chunk + 16);
+            }
+            else if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16){
+                format = read16(chunk + 8);
+                num_channels = read16(chunk + 10);
+                sample_rate = read32(chunk + 12);
+                bits = read16(chunk + 22);
+                // the sub format GUID starts with the format tag
+                if (format == format_extensible && size >= 40) format = read16(chunk + 32);
+                hasFormat = true;
+            }
+            else if (std::memcmp(chunk, "data", 4) == 0){
+                if (! rf64 || size != 0xFFFFFFFF) dataSize = size;
+                data_offset = position + 8;
+                break;
+            }
+            // chunks are padded to an even size
+            position += 8 + (size_t) size + (size & 1);
+        }
+
+        bytes_per_sample = bits / 8;
+        floating_point = format == format_float;
+        const bool supported = (format == format_pcm && (bits == 8 || bits == 16 || bits == 24 || bits == 32))
+                               || (format == format_float && (bits == 32 || bits == 64));
+        if (! hasFormat || data_offset == 0 || num_channels <= 0 || ! supported){
+            close();
+            error = "not an uncompressed WAV file";
+            return false;
+        }
+        // a file that was not finished is read as far as it goes
+        dataSize = std::min<uint64_t>(dataSize, mapped_size - data_offset);
+        length = (int64_t) (dataSize / (uint64_t) (num_channels * bytes_per_sample));
+        released = 0;
+        madvise((void*) data, mapped_size, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    void reader::close(){
+        if (data != nullptr) munmap((void*) data, mapped_size);
+        data = nullptr;
+        mapped_size = 0;
+        data_offset = 0;
+        num_channels = 0;
+        length = 0;
+    }
+
+    void reader::read(int64_t start, int num_frames, float* const* channels){
+        const size_t frameSize = (size_t) (num_channels * bytes_per_sample);
+        const unsigned char* frame = data + data_offset + (size_t) start * frameSize;
+        for (int i = 0; i < num_frames; i++, frame += frameSize){
+            const unsigned char* sample = frame;
+            for (int channel = 0; channel < num_channels; channel++, sample += bytes_per_sample){
+                float value;
+                if (floating_point){
+                    if (bytes_per_sample == 4){
+                        const uint32_t bitsValue = read32(sample);
+                        std::memcpy(&value, &bitsValue, sizeof(value));
+                    }
+                    else{
+                        const uint64_t bitsValue = read64(sample);
+                        double wide;
+                        std::memcpy(&wide, &bitsValue, sizeof(wide));
+                        value = (float) wide;
+                    }
+                }
+                else{
+                    switch (bytes_per_sample){
+                        case 1:  value = (float) ((int) sample[0] - 128) * (1.f / 128.f); break;
+                        case 2:  value = (float) (int16_t) read16(sample) * (1.f / 32768.f); break;
+                        case 3:  value = (float) ((int32_t) (((uint32_t) sample[0] << 8) | ((uint32_t) sample[1] << 16) | ((uint32_t) sample[2] << 24)) >> 8) * (1.f / 8388608.f); break;
+                        default: value = (float) (int32_t) read32(sample) * (1.f / 2147483648.f); break;
+                    }
+                }
+                channels[channel][i] = value;
+            }
+        }
+        release_behind((size_t) (frame - data));
+    }
+
+    void reader::release_behind(size_t offset){
+        const size_t end = offset / page_size() * page_size();
+        if (end < released + release_step) return;
+        madvise((void*) (data + released), end - released, MADV_DONTNEED);
+        released = end;
+    }
+
+    writer::~writer(){
+        close();
+    }
+
+    bool writer::create(const char* path, int channels, double sampleRate, int bits, int64_t frames, std::string& error){
+        close();
+        if (channels <= 0 || (bits != 16 && bits != 24 && bits != 32)){
+            error = "unsupported sample format";
+            return false;
+        }
+        num_channels = channels;
+        bytes_per_sample = bits / 8;
+        length = frames;
+        const uint64_t blockAlign = (uint64_t) (channels * bytes_per_sample);
+        const uint64_t dataSize = (uint64_t) frames * blockAlign;
+        // RIFF, WAVE, fmt with the extensible format, optionally ds64, and the data chunk header
+        const bool rf64 = dataSize + 12 + 48 + 8 > 0xFFFFFFFFull;
+        data_offset = 12 + 48 + (rf64 ? 36 : 0) + 8;
+        mapped_size = data_offset + (size_t) dataSize + (dataSize & 1);
+
+        file = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (file < 0){
+            error = "could not create the file";
+            return false;
+        }
+        // allocates the blocks up front where the file system supports it, otherwise the file is only extended
+       #if defined(__linux__)
+        const bool allocated = posix_fallocate(file, 0, (off_t) mapped_size) == 0;
+       #else
+        const bool allocated = false;
+       #endif
+        if (! allocated && ftruncate(file, (off_t) mapped_size) != 0){
+            close();
+            error = "could not allocate the file";
+            return false;
+        }
+        void* mapping = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (mapping == MAP_FAILED){
+            close();
+            error = "could not map the file";
+            return false;
+        }
+        data = (unsigned char*) mapping;
+        released = 0;
+        madvise(data, mapped_size, MADV_SEQUENTIAL);
+
+        unsigned char* p = data;
+        p = write_id(p, rf64 ? "RF64" : "RIFF");
+        p = write32(p, rf64 ? 0xFFFFFFFF : (uint32_t) (mapped_size - 8));
+        p = write_id(p, "WAVE");
+        if (rf64){
+            p = write_id(p, "ds64");
+            p = write32(p, 28);
+            p = write64(p, (uint64_t) mapped_size - 8);
+            p = write64(p, dataSize);
+            p = write64(p, (uint64_t) frames);
+            p = write32(p, 0);
+        }
+        p = write_id(p, "fmt ");
+        p = write32(p, 40);
+        p = write16(p, format_extensible);
+        p = write16(p, (uint16_t) channels);
+        p = write32(p, (uint32_t) sampleRate);
+        p = write32(p, (uint32_t) (sampleRate * (double) blockAlign));
+        p = write16(p, (uint16_t) blockAlign);
+        p = write16(p, (uint16_t) bits);
+        p = write16(p, 22);
+        p = write16(p, (uint16_t) bits);
+        // no speaker positions, the channels are ambisonic components
+        p = write32(p, 0);
+        static const unsigned char guid_tail[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+        p = write16(p, bits == 32 ? format_float : format_pcm);
+        std::memcpy(p, guid_tail, sizeof(guid_tail));
+        p += sizeof(guid_tail);
+        p = write_id(p, "data");
+        p = write32(p, rf64 ? 0xFFFFFFFF : (uint32_t) dataSize);
+        return true;
+    }
+
+    bool writer::close(){
+        bool ok = true;
+        if (data != nullptr){
+            ok = msync(data, mapped_size, MS_SYNC) == 0;
+            munmap(data, mapped_size);
+        }
+        if (file >= 0) ok = ::close(file) == 0 && ok;
+        data = nullptr;
+        file = -1;
+        mapped_size = 0;
+        return ok;
+    }
+
+    void writer::write(int64_t start, int num_frames, const float* const* channels){
+        const size_t frameSize = (size_t) (num_channels * bytes_per_sample);
+        unsigned char* frame = data + data_offset + (size_t) start * frameSize;
+        for (int i = 0; i < num_frames; i++, frame += frameSize){
+            unsigned char* sample = frame;
+            for (int channel = 0; channel < num_channels; channel++, sample += bytes_per_sample){
+                const float value = channels[channel][i];
+                switch (bytes_per_sample){
+                    case 2: write16(sample, (uint16_t) to_int(value, 16)); break;
+                    case 3:{
+                        const uint32_t v = (uint32_t) to_int(value, 24);
+                        sample[0] = (unsigned char) v;
+                        sample[1] = (unsigned char) (v >> 8);
+                        sample[2] = (unsigned char) (v >> 16);
+                        break;
+                    }
+                    default:{
+                        uint32_t bitsValue;
+                        std::memcpy(&bitsValue, &value, sizeof(bitsValue));
+                        write32(sample, bitsValue);
+                        break;
+                    }
+                }
+            }
+        }
+        release_behind((size_t) (frame - data));
+    }
+
+    void writer::release_behind(size_t offset){
+        const size_t end = offset / page_size() * page_size();
+        if (end < released + release_step) return;
+        // the written pages stay in the page cache until the kernel writes them back
+        msync(data + released, end - released, MS_ASYNC);
+        madvise(data + released, end - released, MADV_DONTNEED);
+        released = end;
+    }
+}
+
+#else
+
+namespace mapped_wav
+{
+    bool is_supported() { return false; }
+
+    reader::~reader() {}
+    bool reader::open(const char*, std::string& error) { error = "memory mapped files are not supported"; return false; }
+    void reader::close() {}
+    void reader::read(int64_t, int, float* const*) {}
+    void reader::release_behind(size_t) {}
+
+    writer::~writer() {}
+    bool writer::create(const char*, int, double, int, int64_t, std::string& error) { error = "memory mapped files are not supported"; return false; }
+    bool writer::close() { return true; }
+    void writer::write(int64_t, int, const float* const*) {}
+    void writer::release_behind(size_t) {}
+}
+
+#endif
@@ -0,0 +1,106 @@
+/**
+ * \file mapped_wav.h
+ *
+ * \brief Reads and writes uncompressed WAV and RF64 files through memory mappings.
+ *
+ * \details Used by reverb-render for long multichannel files, where the buffered reads and writes of the JUCE audio formats cost more than the diffuse model. The reader maps the whole file and converts the interleaved samples of a range of frames straight into the planar channel buffers of the processor. The writer creates the file with its final size, so the blocks are allocated once, maps it and writes the frames into the mapping. Both tell the kernel that the file is accessed sequentially and drop the pages behind the current position from the mapping, so the memory use of the process stays constant for any file size.
+ *
+ * Supported are 8, 16, 24 and 32 bit integer and 32 and 64 bit floating point samples in RIFF, RF64 and BW64 files, the writer writes 16 and 24 bit integer and 32 bit floating point samples with WAVE_FORMAT_EXTENSIBLE and switches to RF64 above 4 GB. Without POSIX memory mappings open and create fail and reverb-render uses the JUCE audio formats.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#ifndef mapped_wav_h
+#define mapped_wav_h
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace mapped_wav
+{
+    /// \brief Checks whether memory mapped files are available on this system
+    bool is_supported();
+
+    class reader{
+    public:
+        reader() = default;
+        ~reader();
+
+        reader(const reader&) = delete;
+        reader& operator=(const reader&) = delete;
+
+        /// \brief mapped_wav::reader::open Maps a WAV or RF64 file
+        /// \param error set to the reason if the file cannot be read
+        /// \return false if the file cannot be mapped or is not an uncompressed WAV file
+        bool open(const char* path, std::string& error);
+
+        /// \brief mapped_wav::reader::close Unmaps the file
+        void close();
+
+        int get_num_channels() const { return num_channels; }
+        double get_sample_rate() const { return sample_rate; }
+        /// \brief mapped_wav::reader::get_length Gets the number of frames
+        int64_t get_length() const { return length; }
+
+        /// \brief mapped_wav::reader::read Converts frames to float, the frames should be read in increasing order
+        /// \param start the first frame, start + num_frames must not exceed the length
+        /// \param channels planar destination buffers, one per channel of the file
+        void read(int64_t start, int num_frames, float* const* channels);
+
+    private:
+        void release_behind(size_t offset);
+
+        const unsigned char* data = nullptr;
+        size_t mapped_size = 0;
+        /// offset of the first sample in the mapping
+        size_t data_offset = 0;
+        /// pages before this offset were given back to the kernel
+        size_t released = 0;
+        int num_channels = 0;
+        double sample_rate = 0.0;
+        int64_t length = 0;
+        int bytes_per_sample = 0;
+        bool floating_point = false;
+    };
+
+    class writer{
+    public:
+        writer() = default;
+        ~writer();
+
+        writer(const writer&) = delete;
+        writer& operator=(const writer&) = delete;
+
+        /// \brief mapped_wav::writer::create Creates a file with its final size and maps it
+        /// \param bits 16 or 24 for integer, 32 for floating point samples
+        /// \param length the number of frames that will be written
+        /// \param error set to the reason if the file cannot be created
+        bool create(const char* path, int num_channels, double sample_rate, int bits, int64_t length, std::string& error);
+
+        /// \brief mapped_wav::writer::close Writes the mapping back and unmaps the file
+        /// \return false if the file could not be written completely
+        bool close();
+
+        /// \brief mapped_wav::writer::write Converts frames from float, the frames should be written in increasing order
+        /// \param start the first frame, start + num_frames must not exceed the length given to create
+        /// \param channels planar source buffers, one per channel of the file
+        void write(int64_t start, int num_frames, const float* const* channels);
+
+    private:
+        void release_behind(size_t offset);
+
+        unsigned char* data = nullptr;
+        size_t mapped_size = 0;
+        size_t data_offset = 0;
+        size_t released = 0;
+        int num_channels = 0;
+        int bytes_per_sample = 0;
+        int64_t length = 0;
+        int file = -1;
+    };
+}
+
+#endif /* mapped_wav_h */
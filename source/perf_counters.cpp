@@ -0,0 +1,177 @@
+/**
+ * \file perf_counters.cpp
+ *
+ * \brief Source for perf_counters class
+ *
+ * \class perf_counters
+ *
+ */
+
+#include "perf_counters.h"
+
+#if defined(__linux__) && REVERB_PERF_COUNTERS
+
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+    int open_event(uint32_t type, uint64_t config, int group){
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = type;
+        attributes.config = config;
+        attributes.disabled = group == -1 ? 1 : 0;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        attributes.read_format = PERF_FORMAT_GROUP;
+        // this thread only, on any CPU
+        return (int) syscall(SYS_perf_event_open, &attributes, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+    }
+
+    constexpr uint64_t cache_miss(uint64_t cache){
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+}
+
+bool perf_counters::is_compiled_in() { return true; }
+
+bool perf_counters::open(){
+    close();
+    const struct { uint32_t type; uint64_t config; } events[num_events] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D)},
+        {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    };
+
+    uint32_t mask = 0;
+    for (int e = 0; e < num_events; e++){
+        fds[e] = open_event(events[e].type, events[e].config, e == cycles ? -1 : fds[cycles]);
+        if (fds[e] >= 0){
+            group_index[e] = group_size++;
+            mask |= 1u << e;
+        }
+        // without the leader there is no group
+        if (e == cycles && fds[e] < 0) break;
+    }
+    available.store(mask, std::memory_order_relaxed);
+    if (fds[cycles] < 0) return false;
+
+    ioctl(fds[cycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds[cycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+void perf_counters::close(){
+    for (int e = 0; e < num_events; e++){
+        if (fds[e] >= 0) ::close(fds[e]);
+        fds[e] = -1;
+        group_index[e] = -1;
+    }
+    group_size = 0;
+}
+
+bool perf_counters::read(uint64_t* values){
+    // PERF_FORMAT_GROUP gives the number of events followed by their values
+    uint64_t data[1 + num_events];
+    if (::read(fds[cycles], data, sizeof(data)) < (ssize_t) ((1 + group_size) * sizeof(uint64_t))) return false;
+    for (int e = 0; e < num_events; e++) values[e] = group_index[e] >= 0 ? data[1 + group_index[e]] : 0;
+    return true;
+}
+
+#else
+
+bool perf_counters::is_compiled_in() { return false; }
+bool perf_counters::open() { return false; }
+void perf_counters::close() {}
+bool perf_counters::read(uint64_t*) { return false; }
+
+#endif
+
+perf_counters::perf_counters(){
+    for (int e = 0; e < num_events; e++){
+        fds[e] = -1;
+        group_index[e] = -1;
+        last[e] = 0;
+    }
+    reopen_requested.store(false);
+    blocks.store(0);
+    available.store(0);
+    for (auto& stageCounts : counts)
+        for (auto& count : stageCounts) count.store(0);
+}
+
+perf_counters::~perf_counters(){
+    close();
+}
+
+void perf_counters::prepare(){
+    blocks.store(0, std::memory_order_relaxed);
+    for (auto& stageCounts : counts)
+        for (auto& count : stageCounts) count.store(0, std::memory_order_relaxed);
+    reopen_requested.store(true, std::memory_order_release);
+}
+
+bool perf_counters::begin_block(){
+    if (! is_compiled_in()) return false;
+
+    if (reopen_requested.exchange(false, std::memory_order_acquire)){
+        close();
+        open_attempted = false;
+    }
+    if (! open_attempted){
+        // opened here, because the counters belong to the thread that opens them
+        open_attempted = true;
+        open();
+    }
+    return fds[cycles] >= 0 && read(last);
+}
+
+void perf_counters::end_stage(stage s){
+    uint64_t values[num_events];
+    if (! read(values)) return;
+    for (int e = 0; e < num_events; e++){
+        // single writer, so a plain load and store is enough
+        counts[s][e].store(counts[s][e].load(std::memory_order_relaxed) + (values[e] - last[e]), std::memory_order_relaxed);
+        last[e] = values[e];
+    }
+}
+
+void perf_counters::end_block(){
+    blocks.store(blocks.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+perf_counters::statistics perf_counters::get_statistics() const{
+    statistics result;
+    result.blocks = blocks.load(std::memory_order_acquire);
+    result.available = available.load(std::memory_order_relaxed);
+    for (int s = 0; s < num_stages; s++)
+        for (int e = 0; e < num_events; e++) result.counts[s][e] = counts[s][e].load(std::memory_order_relaxed);
+    return result;
+}
+
+const char* perf_counters::get_stage_name(stage s){
+    switch (s){
+        case comb_bank:     return "comb bank";
+        case allpass_chain: return "allpass chain";
+        case mixing:        return "mixing";
+        default:            return "";
+    }
+}
+
+const char* perf_counters::get_event_name(event e){
+    switch (e){
+        case cycles:        return "cycles";
+        case instructions:  return "instructions";
+        case l1d_misses:    return "L1D misses";
+        case llc_misses:    return "LLC misses";
+        case branch_misses: return "branch misses";
+        default:            return "";
+    }
+}
@@ -0,0 +1,83 @@
+/**
+ * \file perf_counters.h
+ *
+ * \brief Hardware performance counters of the processing stages, per block.
+ *
+ * \details Built with REVERB_PERF_COUNTERS on Linux, the audio thread opens a perf_event_open group with the CPU cycles, retired instructions, L1 data cache misses, last level cache misses and branch misses of its own thread on the first block after prepare. processBlock then runs the diffuse model stage by stage instead of in tiles, the comb_filter bank of all channels, the allpass_filter chain of all channels and the mixing of the input and ACN0, and reads the group after every stage. The deltas are summed per stage, perf_counters::get_statistics and the telemetry give the totals and the number of blocks.
+ *
+ * Reading the group is a read system call, so this is an instrumentation mode and not meant for production builds, the real-time check of the processor benchmark reports it. Without REVERB_PERF_COUNTERS, on other systems or if the kernel does not allow counting (perf_event_paranoid, no PMU in a virtual machine) perf_counters::begin_block returns false and processBlock runs unchanged.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#ifndef perf_counters_h
+#define perf_counters_h
+
+#include <atomic>
+#include <cstdint>
+
+class perf_counters{
+public:
+    enum event { cycles, instructions, l1d_misses, llc_misses, branch_misses, num_events };
+    enum stage { comb_bank, allpass_chain, mixing, num_stages };
+
+    /// \brief Counter totals since the last prepare
+    struct statistics{
+        /// number of counted blocks
+        uint64_t blocks;
+        /// bit i is set if event i could be opened
+        uint32_t available;
+        uint64_t counts[num_stages][num_events];
+    };
+
+    perf_counters();
+    ~perf_counters();
+
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+
+    /// \brief perf_counters::is_compiled_in Checks whether the counters were built in
+    static bool is_compiled_in();
+
+    /// \brief perf_counters::prepare Clears the totals and reopens the counters on the next block, the audio thread may have changed, not real-time safe
+    void prepare();
+
+    /// \brief perf_counters::begin_block Starts counting a block, called by the audio thread only
+    /// \return true if the counters are open and the block should be processed stage by stage
+    bool begin_block();
+
+    /// \brief perf_counters::end_stage Adds the counts since the last call to a stage
+    void end_stage(stage s);
+
+    /// \brief perf_counters::end_block Finishes a block started with begin_block
+    void end_block();
+
+    /// \brief perf_counters::get_statistics Gets the totals, may be called from any thread
+    statistics get_statistics() const;
+
+    static const char* get_stage_name(stage s);
+    static const char* get_event_name(event e);
+
+private:
+    bool open();
+    void close();
+    bool read(uint64_t* values);
+
+    /// file descriptors of the events, -1 if not available, cycles is the group leader
+    int fds[num_events];
+    /// position of every event in the group read
+    int group_index[num_events];
+    int group_size = 0;
+    uint64_t last[num_events];
+    /// the counters are only opened once per prepare, also if that fails
+    bool open_attempted = false;
+    std::atomic<bool> reopen_requested;
+
+    std::atomic<uint64_t> blocks;
+    std::atomic<uint32_t> available;
+    std::atomic<uint64_t> counts[num_stages][num_events];
+};
+
+#endif /* perf_counters_h */
@@ -0,0 +1,99 @@
+/**
+ * \file plugin_state.cpp
+ *
+ * \brief Source for the plugin state format
+ *
+ * \details Layout, all fields little endian:
+ *
+ *     offset  0  uint32  magic
+ *     offset  4  uint16  version
+ *     offset  6  uint16  size of the record in bytes
+ *     offset  8  float32 dry
+ *     offset 12  float32 wet
+ *     offset 16  float32 room size
+ *     offset 20  float32 damping
+ *     offset 24  uint8   freeze
+ *     offset 25  uint8   reserved, 0
+ *     offset 26  uint16  reserved, 0
+ *     offset 28  uint32  reserved, 0 (the output channel count of early version 1 records, ignored)
+ *
+ * appended by version 2:
+ *
+ *     offset 32  uint8   comb filters per channel of the orders 1 to 7
+ *     offset 39  uint8   reserved, 0
+ *     offset 40  uint8   allpass filters per channel of the orders 1 to 7
+ *     offset 47  uint8   reserved, 0
+ *
+ */
+
+#include "plugin_state.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace plugin_state
+{
+    namespace
+    {
+        void put32(uint8_t* p, uint32_t v){
+            for (int i = 0; i < 4; i++) p[i] = (uint8_t) (v >> (8 * i));
+        }
+
+        uint32_t get32(const uint8_t* p){
+            return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+        }
+
+        void put_float(uint8_t* p, float v){
+            uint32_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            put32(p, bits);
+        }
+
+        float get_float(const uint8_t* p){
+            const uint32_t bits = get32(p);
+            float v;
+            std::memcpy(&v, &bits, sizeof(v));
+            return v;
+        }
+    }
+
+    size_t write(const values& state, uint8_t (&buffer)[maximum_size]){
+        std::memset(buffer, 0, sizeof(buffer));
+        put32(buffer, magic);
+        buffer[4] = (uint8_t) version;
+        buffer[5] = (uint8_t) (version >> 8);
+        buffer[6] = (uint8_t) record_size;
+        buffer[7] = (uint8_t) (record_size >> 8);
+        put_float(buffer + 8, state.dry);
+        put_float(buffer + 12, state.wet);
+        put_float(buffer + 16, state.room);
+        put_float(buffer + 20, state.damp);
+        buffer[24] = state.freeze ? 1 : 0;
+        std::memcpy(buffer + 32, state.detail_combs, detail_orders);
+        std::memcpy(buffer + 40, state.detail_allpasses, detail_orders);
+        return record_size;
+    }
+
+    bool read(const void* data, size_t size, values& state){
+        const uint8_t* p = (const uint8_t*) data;
+        if (p == nullptr || size < minimum_size || get32(p) != magic) return false;
+        const size_t recordSize = (size_t) (p[6] | (p[7] << 8));
+        const uint16_t recordVersion = (uint16_t) (p[4] | (p[5] << 8));
+        if (recordVersion < 1 || recordSize < minimum_size || recordSize > size) return false;
+
+        const float parameters[4] = {get_float(p + 8), get_float(p + 12), get_float(p + 16), get_float(p + 20)};
+        for (float parameter : parameters) if (! std::isfinite(parameter)) return false;
+
+        state.dry = std::clamp(parameters[0], 0.f, 1.f);
+        state.wet = std::clamp(parameters[1], 0.f, 1.f);
+        state.room = std::clamp(parameters[2], 0.f, 1.f);
+        state.damp = std::clamp(parameters[3], 0.f, 1.f);
+        state.freeze = p[24] != 0;
+        if (recordVersion >= 2 && recordSize >= 48){
+            std::memcpy(state.detail_combs, p + 32, detail_orders);
+            std::memcpy(state.detail_allpasses, p + 40, detail_orders);
+        }
+        return true;
+    }
+}
@@ -0,0 +1,56 @@
+/**
+ * \file plugin_state.h
+ *
+ * \brief Versioned binary format of the plugin state that hosts store in sessions and presets.
+ *
+ * \details The state is a fixed little endian record: the magic "RVRS", the version and the size of the record, followed by the parameters and the detail profile. The bus layout and with it the ambisonic order belong to the host, the state applies to any order. plugin_state::write encodes it into a fixed size array, so saving needs no heap allocation apart from the block the host hands in. Later versions only append fields, plugin_state::read takes the fields it knows from any record of at least the size of version 1 and leaves the defaults for the others, so old sessions open in new builds and new sessions in old builds. The parameters are clamped to their ranges and records that are truncated, have another magic or contain values that are not finite are rejected as a whole.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#ifndef plugin_state_h
+#define plugin_state_h
+
+#include <cstddef>
+#include <cstdint>
+
+namespace plugin_state
+{
+    /// "RVRS", the first word of every state
+    constexpr uint32_t magic = 0x53525652;
+    /// incremented whenever fields are appended
+    constexpr uint16_t version = 2;
+    /// size of a version 1 record, the smallest record that is read
+    constexpr size_t minimum_size = 32;
+    /// size of the records plugin_state::write encodes
+    constexpr size_t record_size = 48;
+    /// number of ambisonic orders with a detail profile entry, 1 to 7
+    constexpr int detail_orders = 7;
+    /// size of the array plugin_state::write encodes into
+    constexpr size_t maximum_size = 64;
+
+    struct values{
+        float dry;
+        float wet;
+        float room;
+        float damp;
+        bool freeze;
+        /// comb_filter instances per channel of the orders 1 to 7, since version 2
+        uint8_t detail_combs[detail_orders];
+        /// allpass_filter instances per channel of the orders 1 to 7, since version 2
+        uint8_t detail_allpasses[detail_orders];
+    };
+
+    /// \brief Encodes the values into a buffer
+    /// \return the number of bytes written
+    size_t write(const values& state, uint8_t (&buffer)[maximum_size]);
+
+    /// \brief Decodes a state written by any version of plugin_state::write
+    /// \param state holds the defaults for the fields the record does not contain, unchanged if the record is rejected
+    /// \return false if the record is not a valid state
+    bool read(const void* data, size_t size, values& state);
+}
+
+#endif /* plugin_state_h */
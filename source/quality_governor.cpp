@@ -0,0 +1,99 @@
+/**
+ * \file quality_governor.cpp
+ *
+ * \brief Source for quality_governor class
+ *
+ * \class quality_governor
+ *
+ */
+
+#include "quality_governor.h"
+#include "block_load_monitor.h"
+#include "tuning.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    /// time constant of the smoothed load in seconds
+    constexpr double smoothing_time = 0.05;
+    /// time after a tier change before the quality is lowered again, in seconds
+    constexpr double settle_time = 0.25;
+}
+
+quality_governor::quality_governor(){
+    set_settings(default_settings());
+    tier.store(0);
+    tier_changes.store(0);
+    seconds_per_tick.store(1.0 / block_load_monitor::ticks_per_second());
+}
+
+quality_governor::settings quality_governor::default_settings(){
+    settings s;
+    s.enabled = false;
+    s.upper_load = 0.8f;
+    s.lower_load = 0.5f;
+    s.hold_time = 2.f;
+    s.max_tier = numqualitytiers - 1;
+    return s;
+}
+
+void quality_governor::prepare(double sampleRate){
+    sample_rate = sampleRate;
+    smoothed_load = 0.0;
+    time_below = 0.0;
+    time_since_change = 0.0;
+    tier.store(0, std::memory_order_relaxed);
+    tier_changes.store(0, std::memory_order_relaxed);
+}
+
+void quality_governor::set_settings(const settings& s){
+    enabled.store(s.enabled, std::memory_order_relaxed);
+    upper_load.store(s.upper_load, std::memory_order_relaxed);
+    lower_load.store(std::min(s.lower_load, s.upper_load), std::memory_order_relaxed);
+    hold_time.store(std::max(0.f, s.hold_time), std::memory_order_relaxed);
+    max_tier.store(std::clamp(s.max_tier, 0, numqualitytiers - 1), std::memory_order_relaxed);
+}
+
+quality_governor::settings quality_governor::get_settings() const{
+    settings s;
+    s.enabled = enabled.load(std::memory_order_relaxed);
+    s.upper_load = upper_load.load(std::memory_order_relaxed);
+    s.lower_load = lower_load.load(std::memory_order_relaxed);
+    s.hold_time = hold_time.load(std::memory_order_relaxed);
+    s.max_tier = max_tier.load(std::memory_order_relaxed);
+    return s;
+}
+
+void quality_governor::set_tier(int value){
+    tier.store(value, std::memory_order_relaxed);
+    tier_changes.store(tier_changes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    time_below = 0.0;
+    time_since_change = 0.0;
+}
+
+void quality_governor::record(uint64_t ticks, int numSamples){
+    if (numSamples <= 0) return;
+
+    const int current = tier.load(std::memory_order_relaxed);
+    const int lowest = enabled.load(std::memory_order_relaxed) ? max_tier.load(std::memory_order_relaxed) : 0;
+    if (current > lowest){
+        set_tier(lowest);
+        return;
+    }
+
+    const double duration = numSamples / sample_rate;
+    const double load = (double) ticks * seconds_per_tick.load(std::memory_order_relaxed) / duration;
+    smoothed_load += (load - smoothed_load) * (1.0 - std::exp(-duration / smoothing_time));
+    time_since_change += duration;
+
+    if ((load > 1.0 || smoothed_load > upper_load.load(std::memory_order_relaxed)) && current < lowest){
+        if (time_since_change >= settle_time) set_tier(current + 1);
+        return;
+    }
+
+    if (smoothed_load < lower_load.load(std::memory_order_relaxed)) time_below += duration;
+    else time_below = 0.0;
+    if (current > 0 && time_below >= hold_time.load(std::memory_order_relaxed)) set_tier(current - 1);
+}
@@ -0,0 +1,85 @@
+/**
+ * \file quality_governor.h
+ *
+ * \brief Steps the diffuse model through quality tiers when processBlock gets close to its deadline.
+ *
+ * \details The audio thread passes the processing time of every block to quality_governor::record, like to the block_load_monitor. The governor smooths the load (processing time divided by the block deadline) over about 50 ms and moves to the next lower quality tier when the smoothed load exceeds the upper threshold or a block misses its deadline. It moves one tier up again once the smoothed load stayed below the lower threshold for the hold time. Between the two thresholds nothing changes, and after every step the governor waits a settle time before it steps down further, so that the smoothed load reflects the new tier. The tiers themselves are defined by quality_tier_combs in tuning.h, tier 0 is the full diffuse model.
+ *
+ * The settings are atomics, so the governor of every instance can be configured from any thread while the audio thread runs. The audio thread is the only writer of the tier.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#ifndef quality_governor_h
+#define quality_governor_h
+
+#include <atomic>
+#include <cstdint>
+
+class quality_governor{
+public:
+    /// \brief Configuration of a governor
+    struct settings{
+        /// false keeps the governor at tier 0, the default, the standalone app turns it on
+        bool enabled;
+        /// smoothed load above which the quality is lowered, as a fraction of the deadline
+        float upper_load;
+        /// smoothed load below which the quality is raised again
+        float lower_load;
+        /// time the smoothed load must stay below lower_load before a tier is raised, in seconds
+        float hold_time;
+        /// lowest quality the governor may step down to
+        int max_tier;
+    };
+
+    quality_governor();
+
+    /// \brief quality_governor::prepare Sets the sample rate the deadlines are computed with and returns to tier 0, not real-time safe
+    /// \param sampleRate the sample rate
+    void prepare(double sampleRate);
+
+    /// \brief quality_governor::record Records one block and steps the tier if needed, called by the audio thread only
+    /// \param ticks the processing time in block_load_monitor::read_ticks units
+    /// \param numSamples the number of samples of the block
+    void record(uint64_t ticks, int numSamples);
+
+    /// \brief quality_governor::get_tier Gets the tier the next block should be processed with, may be called from any thread
+    int get_tier() const { return tier.load(std::memory_order_relaxed); }
+
+    /// \brief quality_governor::get_tier_changes Gets the number of tier changes since prepare, may be called from any thread
+    uint64_t get_tier_changes() const { return tier_changes.load(std::memory_order_relaxed); }
+
+    /// \brief quality_governor::set_settings Configures the governor, may be called from any thread
+    void set_settings(const settings& s);
+
+    /// \brief quality_governor::get_settings Gets the configuration, may be called from any thread
+    settings get_settings() const;
+
+    /// \brief The settings of a new governor
+    static settings default_settings();
+
+private:
+    void set_tier(int value);
+
+    std::atomic<bool> enabled;
+    std::atomic<float> upper_load;
+    std::atomic<float> lower_load;
+    std::atomic<float> hold_time;
+    std::atomic<int> max_tier;
+
+    std::atomic<int> tier;
+    std::atomic<uint64_t> tier_changes;
+    std::atomic<double> seconds_per_tick;
+
+    // state of the audio thread
+    double sample_rate = 48000.0;
+    double smoothed_load = 0.0;
+    /// time the smoothed load has been below lower_load, in seconds
+    double time_below = 0.0;
+    /// time since the last tier change, in seconds
+    double time_since_change = 0.0;
+};
+
+#endif /* quality_governor_h */
@@ -0,0 +1,133 @@
+/**
+ * \file telemetry.cpp
+ *
+ * \brief Source for the shared memory telemetry
+ *
+ * \details The counters are copied with memcpy between two fences, the usual seqlock construction. The segment has a fixed size, so a reader only needs the version check before it trusts the layout.
+ *
+ */
+
+#include "telemetry.h"
+
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace telemetry
+{
+    publisher::~publisher(){
+        close();
+    }
+
+    bool publisher::open(){
+        close();
+        pid = (int32_t) getpid();
+        name = "/" + std::string(segment_prefix) + std::to_string((long) pid);
+
+        const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        if (ftruncate(fd, sizeof(segment)) != 0){
+            ::close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+        void* memory = mmap(nullptr, sizeof(segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED){
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        // the memory is zeroed, so the sequence number starts even and the magic is written last
+        shared = static_cast<segment*>(memory);
+        shared->version = segment_version;
+        shared->size = sizeof(segment);
+        std::atomic_thread_fence(std::memory_order_release);
+        shared->magic = segment_magic;
+        return true;
+    }
+
+    void publisher::close(){
+        if (shared == nullptr) return;
+        munmap(shared, sizeof(segment));
+        shm_unlink(name.c_str());
+        shared = nullptr;
+    }
+
+    void publisher::publish(const counters& data){
+        if (shared == nullptr) return;
+        const uint32_t sequence = shared->sequence.load(std::memory_order_relaxed);
+        shared->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&shared->data, &data, sizeof(counters));
+        shared->data.pid = pid;
+        shared->sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    bool read(const segment& shared, counters& data){
+        if (shared.magic != segment_magic || shared.version != segment_version || shared.size != sizeof(segment)) return false;
+
+        for (int attempt = 0; attempt < 100; attempt++){
+            const uint32_t before = shared.sequence.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            std::memcpy(&data, &shared.data, sizeof(counters));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (shared.sequence.load(std::memory_order_relaxed) == before) return true;
+        }
+        return false;
+    }
+
+    std::vector<std::string> list_segments(){
+        std::vector<std::string> names;
+#if defined(__linux__)
+        // macOS has no way to enumerate shared memory objects
+        DIR* directory = opendir("/dev/shm");
+        if (directory == nullptr) return names;
+        while (const dirent* entry = readdir(directory)){
+            if (std::strncmp(entry->d_name, segment_prefix, std::strlen(segment_prefix)) == 0) names.push_back("/" + std::string(entry->d_name));
+        }
+        closedir(directory);
+#endif
+        return names;
+    }
+
+    const segment* map(const std::string& name){
+        const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return nullptr;
+        struct stat status;
+        if (fstat(fd, &status) != 0 || status.st_size < (off_t) sizeof(segment)){
+            ::close(fd);
+            return nullptr;
+        }
+        void* memory = mmap(nullptr, sizeof(segment), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        return memory == MAP_FAILED ? nullptr : static_cast<const segment*>(memory);
+    }
+
+    void unmap(const segment* shared){
+        if (shared != nullptr) munmap(const_cast<segment*>(shared), sizeof(segment));
+    }
+}
+
+#else
+
+namespace telemetry
+{
+    publisher::~publisher() {}
+    bool publisher::open() { return false; }
+    void publisher::close() {}
+    void publisher::publish(const counters&) {}
+
+    bool read(const segment&, counters&) { return false; }
+    std::vector<std::string> list_segments() { return {}; }
+    const segment* map(const std::string&) { return nullptr; }
+    void unmap(const segment*) {}
+}
+
+#endif
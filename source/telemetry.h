@@ -0,0 +1,119 @@
+/**
+ * \file telemetry.h
+ *
+ * \brief Publishes the live counters of a running instance in a POSIX shared memory segment.
+ *
+ * \details Every standalone instance creates the segment /reverb-<pid> (/dev/shm/reverb-<pid> on Linux) and copies its counters into it a few times per second: the processing load histogram of the block_load_monitor, the xruns of the audio device, the number of active channels, whether the delay lines are being resized, the quality tier the governor selected and the number of denormal and not finite output samples and, in instrumentation builds, the hardware counters of the processing stages. The reverb-stat tool reads the segments of all instances without disturbing them.
+ *
+ * The segment is a seqlock. The publisher, a single thread that is never the audio thread, makes the sequence number odd, copies the counters and makes it even again. A reader copies the counters and retries if the sequence number was odd or changed meanwhile, so neither side ever waits for the other and a crashed reader cannot block the instance.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#ifndef telemetry_h
+#define telemetry_h
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "block_load_monitor.h"
+#include "perf_counters.h"
+
+namespace telemetry
+{
+    /// "RVBT", the first word of every segment
+    constexpr uint32_t segment_magic = 0x54425652;
+    /// incremented whenever the layout of telemetry::counters changes
+    constexpr uint32_t segment_version = 3;
+    /// prefix of the segment names, followed by the process id
+    constexpr const char* segment_prefix = "reverb-";
+
+    /// \brief The published counters, plain data that is copied as a whole
+    struct counters{
+        /// process id of the instance, filled in by the publisher
+        int32_t pid;
+        /// number of output channels of the diffuse model
+        int32_t active_channels;
+        double sample_rate;
+        int32_t block_size;
+        /// 1 while the delay lines run towards a new room size
+        int32_t resize_in_progress;
+        int32_t freeze;
+        /// quality tier of the diffuse model, 0 is the full model (see quality_governor.h)
+        int32_t quality_tier;
+        /// xruns reported by the audio device
+        int32_t xruns;
+        /// system clock at the last publish, in ms since the epoch
+        uint64_t update_time_ms;
+        uint64_t denormal_samples;
+        uint64_t non_finite_samples;
+        /// instruction set of the diffuse model kernels
+        char kernels[16];
+        /// name of the audio device, the JACK client name with JACK
+        char device[64];
+        block_load_monitor::statistics load;
+        uint64_t load_histogram[block_load_monitor::num_buckets];
+        /// hardware counter totals of the processing stages, no blocks unless built with REVERB_PERF_COUNTERS
+        perf_counters::statistics perf;
+    };
+
+    /// \brief Layout of the shared memory segment
+    struct segment{
+        uint32_t magic;
+        uint32_t version;
+        uint32_t size;
+        /// odd while the publisher writes the counters
+        std::atomic<uint32_t> sequence;
+        counters data;
+    };
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "the sequence number is shared between processes");
+
+    /// \brief Creates the segment of this process and publishes counters into it
+    class publisher{
+    public:
+        publisher() = default;
+        ~publisher();
+
+        publisher(const publisher&) = delete;
+        publisher& operator=(const publisher&) = delete;
+
+        /// \brief publisher::open Creates the segment /reverb-<pid>, not real-time safe
+        /// \return false if shared memory is not available
+        bool open();
+
+        /// \brief publisher::close Removes the segment
+        void close();
+
+        /// \brief publisher::is_open Checks whether open succeeded
+        bool is_open() const { return shared != nullptr; }
+
+        /// \brief publisher::publish Copies the counters into the segment, must always be called by the same thread
+        void publish(const counters& data);
+
+    private:
+        segment* shared = nullptr;
+        std::string name;
+        int32_t pid = 0;
+    };
+
+    /// \brief Reads a consistent copy of the counters of a segment
+    /// \return false if the segment does not hold counters of this version or the publisher was too busy
+    bool read(const segment& shared, counters& data);
+
+    /// \brief Lists the names of the segments of all instances
+    std::vector<std::string> list_segments();
+
+    /// \brief Maps a segment read-only, release it with unmap
+    /// \return nullptr if the segment does not exist or is not a telemetry segment
+    const segment* map(const std::string& name);
+
+    /// \brief Releases a segment mapped with map
+    void unmap(const segment* shared);
+}
+
+#endif /* telemetry_h */
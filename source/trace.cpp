@@ -0,0 +1,154 @@
+/**
+ * \file trace.cpp
+ *
+ * \brief Source for the trace recording
+ *
+ * \details A ring is written by one thread only. The writer stores the event and then the new event count with release semantics. The reader loads the count, copies the events and loads the count again, every event older than the second count minus the ring size may have been overwritten during the copy and is dropped.
+ *
+ */
+
+#include "trace.h"
+
+#if REVERB_TRACE
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <vector>
+
+namespace trace
+{
+    namespace
+    {
+        struct event{
+            const char* name;
+            uint64_t ticks;
+            char phase;
+        };
+
+        constexpr int max_threads = 16;
+        constexpr uint64_t ring_size = 1 << 15;
+        /// every trace holds a single process
+        constexpr int pid = 1;
+
+        struct ring{
+            event events[ring_size];
+            std::atomic<uint64_t> count;
+            std::atomic<const char*> thread_name;
+        };
+
+        ring rings[max_threads];
+        std::atomic<int> num_rings {0};
+        /// ring of the calling thread, trivial thread_locals need no constructor call
+        thread_local ring* current = nullptr;
+        thread_local bool claimed = false;
+
+        /// the time stamps are written relative to the start of the program
+        const uint64_t start_ticks = block_load_monitor::read_ticks();
+
+        volatile std::sig_atomic_t signal_received = 0;
+
+        /// \brief Gets the ring of the calling thread, nullptr for the threads beyond max_threads
+        ring* get_ring(){
+            if (! claimed){
+                claimed = true;
+                const int index = num_rings.fetch_add(1, std::memory_order_relaxed);
+                if (index < max_threads) current = &rings[index];
+            }
+            return current;
+        }
+
+        /// \brief Writes a string as a JSON string without the quotes
+        void write_escaped(FILE* file, const char* text){
+            for (; *text != '\0'; text++){
+                if (*text == '"' || *text == '\\') std::fputc('\\', file);
+                if ((unsigned char) *text >= 0x20) std::fputc(*text, file);
+            }
+        }
+    }
+
+    bool is_compiled_in() { return true; }
+
+    void record(const char* name, char phase){
+        ring* r = get_ring();
+        if (r == nullptr) return;
+        const uint64_t count = r->count.load(std::memory_order_relaxed);
+        r->events[count % ring_size] = {name, block_load_monitor::read_ticks(), phase};
+        r->count.store(count + 1, std::memory_order_release);
+    }
+
+    void set_thread_name(const char* name){
+        if (ring* r = get_ring()) r->thread_name.store(name, std::memory_order_relaxed);
+    }
+
+    bool dump(const char* path){
+        FILE* file = std::fopen(path, "w");
+        if (file == nullptr) return false;
+
+        const double microsecondsPerTick = 1.0e6 / block_load_monitor::ticks_per_second();
+        const int numRings = std::min(num_rings.load(std::memory_order_relaxed), max_threads);
+        bool first = true;
+        std::vector<event> events;
+
+        std::fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+        for (int index = 0; index < numRings; index++){
+            ring& r = rings[index];
+            const uint64_t end = r.count.load(std::memory_order_acquire);
+            const uint64_t begin = end > ring_size ? end - ring_size : 0;
+            events.resize((size_t) (end - begin));
+            for (uint64_t i = begin; i < end; i++) events[(size_t) (i - begin)] = r.events[i % ring_size];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t after = r.count.load(std::memory_order_relaxed);
+            const uint64_t valid = after > ring_size ? after - ring_size : 0;
+
+            if (const char* name = r.thread_name.load(std::memory_order_relaxed)){
+                std::fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"", first ? "" : ",\n", pid, index);
+                write_escaped(file, name);
+                std::fprintf(file, "\"}}");
+                first = false;
+            }
+
+            // an end without its begin, cut off by the ring, would confuse the viewer
+            int depth = 0;
+            for (uint64_t i = std::max(begin, valid); i < end; i++){
+                const event& e = events[(size_t) (i - begin)];
+                if (e.phase == 'E' && depth == 0) continue;
+                depth += e.phase == 'B' ? 1 : e.phase == 'E' ? -1 : 0;
+                std::fprintf(file, "%s{\"name\": \"", first ? "" : ",\n");
+                write_escaped(file, e.name);
+                std::fprintf(file, "\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": %d, \"tid\": %d%s}", e.phase, (double) (e.ticks - start_ticks) * microsecondsPerTick, pid, index,
+                             e.phase == 'i' ? ", \"s\": \"t\"" : "");
+                first = false;
+            }
+        }
+        std::fprintf(file, "\n]}\n");
+        return std::fclose(file) == 0;
+    }
+
+    void install_signal_handler(){
+       #if defined(SIGUSR1)
+        std::signal(SIGUSR1, [](int) { signal_received = 1; });
+       #endif
+    }
+
+    bool dump_requested(){
+        if (signal_received == 0) return false;
+        signal_received = 0;
+        return true;
+    }
+}
+
+#else
+
+namespace trace
+{
+    bool is_compiled_in() { return false; }
+    void record(const char*, char) {}
+    void set_thread_name(const char*) {}
+    bool dump(const char*) { return false; }
+    void install_signal_handler() {}
+    bool dump_requested() { return false; }
+}
+
+#endif
@@ -0,0 +1,72 @@
+/**
+ * \file trace.h
+ *
+ * \brief Records spans of the audio and message threads and writes them as Chrome trace event JSON.
+ *
+ * \details Built with REVERB_TRACE, REVERB_TRACE_SCOPE records the begin and the end of the enclosing scope, REVERB_TRACE_INSTANT a single point in time and REVERB_TRACE_THREAD_NAME names the calling thread. Without REVERB_TRACE the macros expand to nothing. The spans cover the stages of processBlock, room size changes, parameter changes, prepareToPlay, which rebuilds the diffuse model, and the JACK process and xrun callbacks.
+ *
+ * Every thread writes into a ring buffer of its own that it claims from a pool allocated with the program, so recording never allocates, locks or waits. When a ring is full the oldest events are overwritten. trace::dump copies the rings from any thread, skips the events that were overwritten while copying and writes a file that chrome://tracing and ui.perfetto.dev open. The standalone app writes reverb-trace-<date>-<time>.json to the temporary directory when it receives SIGUSR1.
+ *
+ * The names must be string literals or live as long as the program.
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#ifndef trace_h
+#define trace_h
+
+#include <cstdint>
+
+#include "block_load_monitor.h"
+
+namespace trace
+{
+    /// \brief Checks whether the tracing was built in
+    bool is_compiled_in();
+
+    /// \brief Records the begin ('B'), the end ('E') or an instant ('i') of a span on the calling thread
+    void record(const char* name, char phase);
+
+    /// \brief Names the calling thread in the trace
+    void set_thread_name(const char* name);
+
+    /// \brief Writes all recorded events as Chrome trace event JSON, not real-time safe
+    /// \return false if tracing is not built in or the file cannot be written
+    bool dump(const char* path);
+
+    /// \brief Makes SIGUSR1 request a dump, checked with trace::dump_requested
+    void install_signal_handler();
+
+    /// \brief Checks and clears a dump request of the signal handler
+    bool dump_requested();
+
+    /// \brief Records a span from its construction to its destruction
+    class scope{
+    public:
+        explicit scope(const char* spanName) : name(spanName) { record(name, 'B'); }
+        ~scope() { record(name, 'E'); }
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+
+    private:
+        const char* name;
+    };
+}
+
+#define REVERB_TRACE_CONCAT_IMPL(a, b) a##b
+#define REVERB_TRACE_CONCAT(a, b) REVERB_TRACE_CONCAT_IMPL(a, b)
+
+#if REVERB_TRACE
+    #define REVERB_TRACE_SCOPE(name) trace::scope REVERB_TRACE_CONCAT(traceScope, __LINE__) (name)
+    #define REVERB_TRACE_INSTANT(name) trace::record(name, 'i')
+    #define REVERB_TRACE_THREAD_NAME(name) trace::set_thread_name(name)
+#else
+    #define REVERB_TRACE_SCOPE(name)
+    #define REVERB_TRACE_INSTANT(name) ((void) 0)
+    #define REVERB_TRACE_THREAD_NAME(name) ((void) 0)
+#endif
+
+#endif /* trace_h */
@@ -43,5 +43,28 @@ const int   spreadvalue    = 23;
 const int   comb_buffer_tuning[numcombs] = {1514, 1612, 1733, 1840, 1929, 2023, 2113, 2194};
 /// initial buffer sizes of the allpass_filter instances
 const int   allpass_buffer_tuning[numallpasses] = {556, 441, 341, 225};
+/// comb_filter instances per channel of the default detail profile, by ambisonic order 1 to 7
+const int   detail_profile_combs[7] = {8, 8, 8, 8, 8, 8, 8};
+/// allpass_filter instances per channel of the default detail profile, by ambisonic order 1 to 7
+const int   detail_profile_allpasses[7] = {4, 4, 4, 4, 4, 4, 4};
+/// comb_filter instances per channel of the reduced detail profile, the high orders are scaled down by the SN3D normalization and need less density
+const int   reduced_detail_combs[7] = {8, 8, 6, 4, 4, 3, 3};
+/// allpass_filter instances per channel of the reduced detail profile
+const int   reduced_detail_allpasses[7] = {4, 4, 4, 3, 3, 2, 2};
+/// number of quality tiers the quality_governor steps through, tier 0 runs the full diffuse model
+const int   numqualitytiers = 4;
+/// comb_filter instances per channel in every quality tier, by ambisonic order 1 to 7, the longest delays are dropped first
+const int   quality_tier_combs[numqualitytiers][7] = {
+    {8, 8, 8, 8, 8, 8, 8},
+    {8, 8, 6, 6, 6, 6, 6},
+    {8, 6, 4, 4, 4, 4, 4},
+    {6, 4, 3, 3, 3, 3, 3}
+};
+/// length of the fade of the comb_filter and allpass_filter instances a quality tier change drops or runs again, in seconds
+const float quality_tier_fade_length = 0.005f;
+/// length of the loop a frozen tail is played from, in seconds, a dense tail repeated every second is heard as a pulse, from about three seconds on the repetition is no longer heard as a rhythm and a longer loop only costs memory (576 kB per channel at 48 kHz)
+const float freeze_loop_length = 3.f;
+/// length of the crossfade from the end of the frozen tail to the start of the loop, in seconds
+const float freeze_crossfade_length = 0.1f;
 
 #endif /* tuning_h */
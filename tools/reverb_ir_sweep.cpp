@@ -0,0 +1,239 @@
+/**
+ * \file reverb_ir_sweep.cpp
+ *
+ * \brief Renders impulse responses of the diffuse model over a grid of room sizes, dampings and sample rates and measures their decay.
+ *
+ * \details Every grid point is rendered by an AudioPluginAudioProcessor with wet 1 and dry 0, so the numbers are the ones of the plugin: the parameters go through parameterChanged, which calls setdamp, and AudioPluginAudioProcessor::reset takes the room size over with setroomsize. An impulse is fed into the input and processBlock runs block by block until the level of the omnidirectional output ACN0 has fallen 70 dB below its maximum or --max-length is reached. RT60, EDT and C80 are computed from the energy decay curve of ACN0 (see decay_analysis.h).
+ *
+ * The grid points are distributed over one worker per thread, every worker keeps a processor and only prepares it again when the sample rate changes. The results are written in grid order, sample rate first, then room size and damping, as CSV or, for a file name ending in .bin, as a binary table:
+ *
+ *     header  char magic[4] = "RVIR", uint32 version = 1, uint32 number of rows, uint32 number of columns = 6
+ *     rows    float32 sample_rate, room, damp, rt60, edt, c80
+ *
+ * in the byte order of the machine, little endian on all supported platforms. Values that could not be measured are NaN.
+ *
+ * A grid axis is given as a list (0.2,0.5,0.8) or as first:last:count (0:1:11).
+ *
+ * Usage: reverb-ir-sweep [--room grid] [--damp grid] [--rate grid] [--order n] [--block samples] [--max-length seconds] [--threads n] [--output results.csv|results.bin]
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PluginProcessor.h"
+#include "decay_analysis.h"
+
+namespace
+{
+    struct options{
+        std::vector<double> rooms {0.0, 0.25, 0.5, 0.75, 1.0};
+        std::vector<double> damps {0.0, 0.33, 0.66, 1.0};
+        std::vector<double> rates {48000.0};
+        int order = 3;
+        int block = 512;
+        double maxLength = 20.0;
+        int threads = 0;
+        std::string output;
+    };
+
+    struct point{
+        double sampleRate;
+        double room;
+        double damp;
+        decay_analysis::parameters decay;
+        /// length of the rendered impulse response in seconds
+        double length;
+    };
+
+    /// \brief A processor that renders all grid points of a worker
+    struct engine{
+        std::unique_ptr<AudioPluginAudioProcessor> processor = std::make_unique<AudioPluginAudioProcessor>();
+        double sampleRate = 0.0;
+        juce::AudioBuffer<float> buffer;
+        juce::MidiBuffer midi;
+        std::vector<float> impulseResponse;
+    };
+
+    [[noreturn]] void usage(const char* program, int exitCode){
+        std::fprintf(stderr, "usage: %s [--room grid] [--damp grid] [--rate grid] [--order n] [--block samples] [--max-length seconds] [--threads n] [--output results.csv|results.bin]\n"
+                             "       a grid is a list (0.2,0.5,0.8) or first:last:count (0:1:11)\n", program);
+        std::exit(exitCode);
+    }
+
+    bool parseGrid(const char* text, std::vector<double>& values){
+        values.clear();
+        const juce::String spec(text);
+        if (spec.containsChar(':')){
+            juce::StringArray parts;
+            parts.addTokens(spec, ":", "");
+            const int count = parts.size() == 3 ? parts[2].getIntValue() : 0;
+            if (count < 1) return false;
+            const double first = parts[0].getDoubleValue(), last = parts[1].getDoubleValue();
+            for (int i = 0; i < count; i++) values.push_back(count == 1 ? first : first + (last - first) * i / (count - 1));
+        }
+        else{
+            juce::StringArray parts;
+            parts.addTokens(spec, ",", "");
+            parts.removeEmptyStrings();
+            for (const auto& part : parts) values.push_back(part.getDoubleValue());
+        }
+        return ! values.empty();
+    }
+
+    options parseOptions(int argc, char* argv[]){
+        options opts;
+        for (int i = 1; i < argc; i++){
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (arg == "--help") usage(argv[0], 0);
+            else if (! hasValue) usage(argv[0], 1);
+            else if (arg == "--room") { if (! parseGrid(argv[++i], opts.rooms)) usage(argv[0], 1); }
+            else if (arg == "--damp") { if (! parseGrid(argv[++i], opts.damps)) usage(argv[0], 1); }
+            else if (arg == "--rate") { if (! parseGrid(argv[++i], opts.rates)) usage(argv[0], 1); }
+            else if (arg == "--order") opts.order = std::atoi(argv[++i]);
+            else if (arg == "--block") opts.block = std::max(16, std::atoi(argv[++i]));
+            else if (arg == "--max-length") opts.maxLength = std::max(0.5, std::atof(argv[++i]));
+            else if (arg == "--threads") opts.threads = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--output") opts.output = argv[++i];
+            else usage(argv[0], 1);
+        }
+        if (opts.order < 0 || opts.order > 7) usage(argv[0], 1);
+        for (double rate : opts.rates) if (rate < 8000.0) usage(argv[0], 1);
+        return opts;
+    }
+
+    /// \brief Renders the impulse response of a grid point into the engine and measures it
+    void render(point& p, engine& e, const options& opts){
+        AudioPluginAudioProcessor& processor = *e.processor;
+        if (p.sampleRate != e.sampleRate){
+            processor.setNonRealtime(true);
+            processor.setRateAndBufferSizeDetails(p.sampleRate, opts.block);
+            processor.prepareToPlay(p.sampleRate, opts.block);
+            e.sampleRate = p.sampleRate;
+        }
+        processor.parameterChanged(PARAM_DRY_ID, 0.f);
+        processor.parameterChanged(PARAM_WET_ID, 1.f);
+        processor.parameterChanged(PARAM_FREEZE_ID, 0.f);
+        processor.parameterChanged(PARAM_DAMP_ID, (float) p.damp);
+        processor.parameterChanged(PARAM_ROOM_SIZE_ID, (float) p.room);
+        // clears the previous impulse response and takes the room size over without resizing
+        processor.reset();
+
+        // the level is tracked in windows of about 50 ms, whole blocks each
+        const int blocksPerWindow = std::max(1, (int) (0.05 * p.sampleRate) / opts.block);
+        const size_t maxSamples = (size_t) (opts.maxLength * p.sampleRate);
+        double windowEnergy = 0.0, maxWindowEnergy = 0.0;
+        int blocksInWindow = 0;
+        e.impulseResponse.clear();
+        while (e.impulseResponse.size() < maxSamples){
+            e.buffer.clear();
+            if (e.impulseResponse.empty()) e.buffer.setSample(0, 0, 1.f);
+            processor.processBlock(e.buffer, e.midi);
+
+            const float* omni = e.buffer.getReadPointer(0);
+            e.impulseResponse.insert(e.impulseResponse.end(), omni, omni + opts.block);
+            for (int i = 0; i < opts.block; i++) windowEnergy += (double) omni[i] * (double) omni[i];
+            if (++blocksInWindow < blocksPerWindow) continue;
+
+            maxWindowEnergy = std::max(maxWindowEnergy, windowEnergy);
+            // 70 dB below the loudest window leaves room for the T30 fit down to -35 dB
+            const bool decayed = windowEnergy <= maxWindowEnergy * 1.0e-7;
+            windowEnergy = 0.0;
+            blocksInWindow = 0;
+            if (decayed && e.impulseResponse.size() >= (size_t) (0.5 * p.sampleRate)) break;
+        }
+        p.length = (double) e.impulseResponse.size() / p.sampleRate;
+        p.decay = decay_analysis::analyse(e.impulseResponse.data(), e.impulseResponse.size(), p.sampleRate);
+    }
+
+    bool writeResults(const std::vector<point>& points, const std::string& path){
+        FILE* file = path.empty() ? stdout : std::fopen(path.c_str(), "wb");
+        if (file == nullptr) return false;
+        if (juce::String(path).endsWithIgnoreCase(".bin")){
+            const char magic[4] = {'R', 'V', 'I', 'R'};
+            const uint32_t header[3] = {1, (uint32_t) points.size(), 6};
+            std::fwrite(magic, 1, sizeof(magic), file);
+            std::fwrite(header, sizeof(uint32_t), 3, file);
+            for (const point& p : points){
+                const float row[6] = {(float) p.sampleRate, (float) p.room, (float) p.damp, (float) p.decay.rt60, (float) p.decay.edt, (float) p.decay.c80};
+                std::fwrite(row, sizeof(float), 6, file);
+            }
+        }
+        else{
+            std::fprintf(file, "sample_rate,room,damp,rt60,edt,c80\n");
+            for (const point& p : points)
+                std::fprintf(file, "%.0f,%.4f,%.4f,%.4f,%.4f,%.3f\n", p.sampleRate, p.room, p.damp, p.decay.rt60, p.decay.edt, p.decay.c80);
+        }
+        return file == stdout ? std::fflush(file) == 0 : std::fclose(file) == 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const options opts = parseOptions(argc, argv);
+
+    // sample rate first, so that the workers rarely prepare their processors again
+    std::vector<point> points;
+    for (double rate : opts.rates)
+        for (double room : opts.rooms)
+            for (double damp : opts.damps) points.push_back({rate, room, damp, {}, 0.0});
+    const int numPoints = (int) points.size();
+    const int numWorkers = std::min(opts.threads > 0 ? opts.threads : juce::SystemStats::getNumCpus(), numPoints);
+
+    // the parameter tree of the processor needs the message manager
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    // created on this thread, the parameter tree of a processor starts a timer
+    std::vector<engine> engines((size_t) numWorkers);
+    const int numOutputs = (opts.order + 1) * (opts.order + 1);
+    for (engine& e : engines){
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(juce::AudioChannelSet::mono());
+        layout.outputBuses.add(juce::AudioChannelSet::discreteChannels(numOutputs));
+        if (! e.processor->setBusesLayout(layout)){
+            std::fprintf(stderr, "the processor does not accept %d output channels\n", numOutputs);
+            return 1;
+        }
+        e.buffer.setSize(numOutputs, opts.block);
+    }
+
+    std::fprintf(stderr, "rendering %d impulse responses of order %d on %d workers\n", numPoints, opts.order, numWorkers);
+    std::atomic<int> nextPoint {0};
+    std::atomic<int> finishedPoints {0};
+    const auto start = std::chrono::steady_clock::now();
+
+    auto runWorker = [&](int worker){
+        for (int index = nextPoint++; index < numPoints; index = nextPoint++){
+            render(points[(size_t) index], engines[(size_t) worker], opts);
+            const int finished = ++finishedPoints;
+            if (finished % 10 == 0 || finished == numPoints) std::fprintf(stderr, "\r%d/%d", finished, numPoints);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int worker = 1; worker < numWorkers; worker++) workers.emplace_back(runWorker, worker);
+    runWorker(0);
+    for (auto& worker : workers) worker.join();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double audioSeconds = 0.0;
+    for (const point& p : points) audioSeconds += p.length;
+    std::fprintf(stderr, "\n%.1f s of impulse responses in %.2f s, realtime factor %.1fx\n", audioSeconds, seconds, audioSeconds / seconds);
+
+    if (! writeResults(points, opts.output)){
+        std::fprintf(stderr, "could not write %s\n", opts.output.c_str());
+        return 1;
+    }
+    return 0;
+}
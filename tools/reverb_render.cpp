@@ -0,0 +1,385 @@
+/**
+ * \file reverb_render.cpp
+ *
+ * \brief Renders audio files through the diffuse model faster than real time.
+ *
+ * \details The input file (WAV, AIFF, FLAC or Ogg, CAF on macOS) is streamed through an AudioPluginAudioProcessor in chunks and written as an ambiX file, ACN channel order with SN3D normalization, as WAV with 32 bit float samples by default. The file grows to RF64 above 4 GB. Only a few chunks of input and output are held in memory, so the memory use does not depend on the length of the file. Uncompressed WAV and RF64 files are memory mapped (see mapped_wav.h), the samples are converted straight between the mapping and the buffers of the processor and the output file is created with its final size, --no-mmap uses the JUCE audio formats for them as well. Other inputs are read ahead on a separate thread while the processor works on the current chunk. A tail of silence is appended to the input, so that the reverb decays in the file, and the file starts with the requested room size.
+ *
+ * All input channels are mixed to mono like in the plugin. The realtime factor, the duration of the rendered audio divided by the rendering time, is printed for every file.
+ *
+ * A single file is rendered with the channels of every chunk distributed over the threads by AudioPluginAudioProcessor::processoffline. With --manifest many files are rendered, one job per line of the manifest in the form of the single file arguments, for example
+ *
+ *     # input output [--order n] [--room v] [--damp v] [--wet v] [--dry v] [--tail seconds] [--bits 16|24|32]
+ *     stems/drums.wav renders/drums_large.wav --order 5 --room 0.9
+ *     "stems/lead vocal.wav" renders/vocal.wav --wet 0.4 --dry 0.6
+ *
+ * Relative paths in the manifest are relative to the manifest. The jobs are run by one worker per thread, every worker renders whole files with an engine of its own. The engine is prepared once and cleared with AudioPluginAudioProcessor::reset between jobs, it is only prepared again when a job needs another sample rate, number of input channels or order. A job that fails does not stop the others. With --log the timing of every job is also written to a CSV file.
+ *
+ * Usage: reverb-render input output.wav [--order n] [--room v] [--damp v] [--wet v] [--dry v] [--tail seconds] [--bits 16|24|32] [--chunk samples] [--threads n] [--no-mmap]
+ *
+ *        reverb-render --manifest jobs.txt [--chunk samples] [--threads n] [--no-mmap] [--log timing.csv]
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PluginProcessor.h"
+#include "mapped_wav.h"
+
+namespace
+{
+    /// \brief A file to render and the parameters to render it with
+    struct job{
+        juce::File input;
+        juce::File output;
+        int order = 3;
+        double tail = 5.0;
+        int bits = 32;
+        std::vector<std::pair<const char*, float>> parameters;
+    };
+
+    struct options{
+        std::vector<job> jobs;
+        juce::File manifest;
+        juce::File log;
+        int chunk = 8192;
+        int threads = 0;
+        /// uncompressed WAV files are accessed through memory mappings where possible
+        bool mapFiles = mapped_wav::is_supported();
+    };
+
+    /// \brief What a rendered job reports
+    struct result{
+        bool ok = false;
+        std::string error;
+        int inputChannels = 0;
+        int outputChannels = 0;
+        double audioSeconds = 0.0;
+        /// time spent opening the files and preparing the engine
+        double setupSeconds = 0.0;
+        double renderSeconds = 0.0;
+        float peak = 0.f;
+        uint64_t nonFiniteSamples = 0;
+    };
+
+    /// \brief A processor that is reused for all jobs of a worker
+    struct engine{
+        std::unique_ptr<AudioPluginAudioProcessor> processor = std::make_unique<AudioPluginAudioProcessor>();
+        double sampleRate = 0.0;
+        int inputChannels = 0;
+        int outputChannels = 0;
+        juce::AudioBuffer<float> buffer;
+        juce::MidiBuffer midi;
+    };
+
+    [[noreturn]] void usage(const char* program, int exitCode){
+        std::fprintf(stderr, "usage: %s input output.wav [--order n] [--room v] [--damp v] [--wet v] [--dry v] [--tail seconds] [--bits 16|24|32] [--chunk samples] [--threads n] [--no-mmap]\n"
+                             "       %s --manifest jobs.txt [--chunk samples] [--threads n] [--no-mmap] [--log timing.csv]\n", program, program);
+        std::exit(exitCode);
+    }
+
+    /// \brief Parses the arguments of one job
+    /// \return false if an argument is unknown or invalid
+    bool parseJob(const juce::StringArray& args, const juce::File& base, job& j){
+        juce::StringArray files;
+        for (int i = 0; i < args.size(); i++){
+            const juce::String& arg = args[i];
+            const bool hasValue = i + 1 < args.size();
+            if (! arg.startsWith("--")) files.add(arg);
+            else if (! hasValue) return false;
+            else if (arg == "--order") j.order = args[++i].getIntValue();
+            else if (arg == "--tail") j.tail = std::max(0.0, args[++i].getDoubleValue());
+            else if (arg == "--bits") j.bits = args[++i].getIntValue();
+            else if (arg == "--room") j.parameters.emplace_back(PARAM_ROOM_SIZE_ID, args[++i].getFloatValue());
+            else if (arg == "--damp") j.parameters.emplace_back(PARAM_DAMP_ID, args[++i].getFloatValue());
+            else if (arg == "--wet") j.parameters.emplace_back(PARAM_WET_ID, args[++i].getFloatValue());
+            else if (arg == "--dry") j.parameters.emplace_back(PARAM_DRY_ID, args[++i].getFloatValue());
+            else return false;
+        }
+        if (files.size() != 2 || j.order < 0 || j.order > 7 || (j.bits != 16 && j.bits != 24 && j.bits != 32)) return false;
+        j.input = base.getChildFile(files[0]);
+        j.output = base.getChildFile(files[1]);
+        return true;
+    }
+
+    /// \brief Reads the jobs of a manifest, one per line, empty lines and lines starting with # are skipped
+    bool readManifest(const juce::File& manifest, std::vector<job>& jobs){
+        if (! manifest.existsAsFile()){
+            std::fprintf(stderr, "could not read the manifest %s\n", manifest.getFullPathName().toRawUTF8());
+            return false;
+        }
+        juce::StringArray lines;
+        manifest.readLines(lines);
+        for (int line = 0; line < lines.size(); line++){
+            const juce::String text = lines[line].trim();
+            if (text.isEmpty() || text.startsWithChar('#')) continue;
+            juce::StringArray args;
+            args.addTokens(text, " \t", "\"");
+            args.removeEmptyStrings();
+            for (auto& arg : args) arg = arg.unquoted();
+            job j;
+            if (! parseJob(args, manifest.getParentDirectory(), j)){
+                std::fprintf(stderr, "%s:%d: invalid job \"%s\"\n", manifest.getFullPathName().toRawUTF8(), line + 1, text.toRawUTF8());
+                return false;
+            }
+            jobs.push_back(std::move(j));
+        }
+        return true;
+    }
+
+    options parseOptions(int argc, char* argv[]){
+        options opts;
+        const juce::File workingDirectory = juce::File::getCurrentWorkingDirectory();
+        juce::StringArray jobArgs;
+        for (int i = 1; i < argc; i++){
+            const juce::String arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (arg == "--help") usage(argv[0], 0);
+            else if (arg == "--manifest" && hasValue) opts.manifest = workingDirectory.getChildFile(argv[++i]);
+            else if (arg == "--log" && hasValue) opts.log = workingDirectory.getChildFile(argv[++i]);
+            else if (arg == "--chunk" && hasValue) opts.chunk = std::max(64, std::atoi(argv[++i]));
+            else if (arg == "--threads" && hasValue) opts.threads = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--no-mmap") opts.mapFiles = false;
+            else jobArgs.add(arg);
+        }
+        if (opts.manifest != juce::File()){
+            if (! jobArgs.isEmpty()) usage(argv[0], 1);
+            if (! readManifest(opts.manifest, opts.jobs)) std::exit(1);
+        }
+        else{
+            job j;
+            if (! parseJob(jobArgs, workingDirectory, j)) usage(argv[0], 1);
+            opts.jobs.push_back(std::move(j));
+        }
+        return opts;
+    }
+
+    /// \brief Sets up the engine for a job, its filters are only reallocated if the configuration changed
+    bool prepareEngine(engine& e, const job& j, double sampleRate, int inputChannels, int chunk, std::string& error){
+        AudioPluginAudioProcessor& processor = *e.processor;
+        const int outputChannels = (j.order + 1) * (j.order + 1);
+        if (sampleRate != e.sampleRate || inputChannels != e.inputChannels || outputChannels != e.outputChannels){
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add(juce::AudioChannelSet::discreteChannels(inputChannels));
+            layout.outputBuses.add(juce::AudioChannelSet::discreteChannels(outputChannels));
+            if (! processor.setBusesLayout(layout)){
+                error = "the processor does not accept " + std::to_string(inputChannels) + " inputs and " + std::to_string(outputChannels) + " outputs";
+                e.sampleRate = 0.0;
+                return false;
+            }
+            processor.setNonRealtime(true);
+            processor.setRateAndBufferSizeDetails(sampleRate, chunk);
+            processor.prepareToPlay(sampleRate, chunk);
+            e.sampleRate = sampleRate;
+            e.inputChannels = inputChannels;
+            e.outputChannels = outputChannels;
+            e.buffer.setSize(std::max(inputChannels, outputChannels), chunk);
+        }
+
+        // the parameters of the previous job must not leak into this one, they are set through the parameter tree like
+        // setStateInformation does, so the stored values, their ranges and the processor stay consistent
+        auto set = [&processor] (const char* parameterID, float value) {
+            if (auto* parameter = processor.parameters.getParameter(parameterID))
+                parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+        };
+        set(PARAM_DRY_ID, initialdry);
+        set(PARAM_WET_ID, initialwet);
+        set(PARAM_ROOM_SIZE_ID, initialroom);
+        set(PARAM_DAMP_ID, initialdamp);
+        set(PARAM_FREEZE_ID, initialfreeze ? 1.f : 0.f);
+        for (const auto& parameter : j.parameters) set(parameter.first, parameter.second);
+        // clears the tail of the previous job and starts with the requested room size
+        processor.reset();
+        return true;
+    }
+
+    /// \brief Renders one job with an engine
+    /// \param pool distributes the channels of every chunk, nullptr processes them on the calling thread
+    /// \param prefetch reads the input ahead if it is not mapped
+    result render(const job& j, engine& e, const options& opts, juce::ThreadPool* pool, juce::TimeSliceThread& prefetch){
+        result r;
+        const int chunk = opts.chunk;
+        const auto setupStart = std::chrono::steady_clock::now();
+
+        // uncompressed WAV files are mapped, everything else is read by the JUCE audio formats
+        mapped_wav::reader mappedInput;
+        std::unique_ptr<juce::BufferingAudioReader> reader;
+        std::string mappingError;
+        const bool mapInput = opts.mapFiles && mappedInput.open(j.input.getFullPathName().toRawUTF8(), mappingError);
+        double sampleRate;
+        juce::int64 inputLength;
+        if (mapInput){
+            sampleRate = mappedInput.get_sample_rate();
+            r.inputChannels = mappedInput.get_num_channels();
+            inputLength = mappedInput.get_length();
+        }
+        else{
+            juce::AudioFormatManager formats;
+            formats.registerBasicFormats();
+            std::unique_ptr<juce::AudioFormatReader> source(formats.createReaderFor(j.input));
+            if (source == nullptr){
+                r.error = "could not read " + j.input.getFullPathName().toStdString() + ", supported formats: " + formats.getWildcardForAllFormats().toStdString();
+                return r;
+            }
+            sampleRate = source->sampleRate;
+            r.inputChannels = std::max(1, (int) source->numChannels);
+            inputLength = source->lengthInSamples;
+            // the reader takes over the source and fills its buffer on the prefetch thread
+            reader = std::make_unique<juce::BufferingAudioReader>(source.release(), prefetch, 4 * chunk);
+            reader->setReadTimeout(-1);
+        }
+        r.outputChannels = (j.order + 1) * (j.order + 1);
+        const juce::int64 totalLength = inputLength + (juce::int64) (j.tail * sampleRate);
+
+        if (! prepareEngine(e, j, sampleRate, r.inputChannels, chunk, r.error)) return r;
+
+        j.output.deleteFile();
+        j.output.getParentDirectory().createDirectory();
+        // the length of the output is known, so the mapped file is created with its final size
+        mapped_wav::writer mappedOutput;
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+        const bool mapOutput = opts.mapFiles && mappedOutput.create(j.output.getFullPathName().toRawUTF8(), r.outputChannels, sampleRate, j.bits, totalLength, mappingError);
+        if (! mapOutput){
+            std::unique_ptr<juce::FileOutputStream> stream(j.output.createOutputStream());
+            if (stream == nullptr){
+                r.error = "could not write " + j.output.getFullPathName().toStdString();
+                return r;
+            }
+            juce::WavAudioFormat wav;
+            writer.reset(wav.createWriterFor(stream.get(), sampleRate, juce::AudioChannelSet::discreteChannels(r.outputChannels), j.bits, {}, 0));
+            if (writer == nullptr){
+                r.error = "could not create a " + std::to_string(r.outputChannels) + " channel WAV writer for " + j.output.getFullPathName().toStdString();
+                return r;
+            }
+            // the writer owns the stream now
+            stream.release();
+        }
+
+        const auto renderStart = std::chrono::steady_clock::now();
+        r.setupSeconds = std::chrono::duration<double>(renderStart - setupStart).count();
+        AudioPluginAudioProcessor& processor = *e.processor;
+        juce::AudioBuffer<float>& buffer = e.buffer;
+        for (juce::int64 position = 0; position < totalLength; position += chunk){
+            const int numSamples = (int) std::min((juce::int64) chunk, totalLength - position);
+            // a shorter last chunk is processed with a shorter buffer, which does not reallocate
+            buffer.setSize(buffer.getNumChannels(), numSamples, false, false, true);
+            buffer.clear();
+            if (position < inputLength){
+                const int numInputSamples = (int) std::min((juce::int64) numSamples, inputLength - position);
+                if (mapInput) mappedInput.read(position, numInputSamples, buffer.getArrayOfWritePointers());
+                else reader->read(&buffer, 0, numInputSamples, position, true, true);
+            }
+
+            if (pool != nullptr) processor.processoffline(buffer, *pool);
+            else processor.processBlock(buffer, e.midi);
+
+            for (int channel = 0; channel < r.outputChannels; channel++) r.peak = std::max(r.peak, buffer.getMagnitude(channel, 0, numSamples));
+            if (mapOutput) mappedOutput.write(position, numSamples, buffer.getArrayOfReadPointers());
+            else if (! writer->writeFromAudioSampleBuffer(buffer, 0, numSamples)){
+                r.error = "could not write " + j.output.getFullPathName().toStdString();
+                return r;
+            }
+        }
+        writer.reset();
+        if (mapOutput && ! mappedOutput.close()){
+            r.error = "could not write " + j.output.getFullPathName().toStdString();
+            return r;
+        }
+        r.renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+        r.audioSeconds = (double) totalLength / sampleRate;
+        r.nonFiniteSamples = processor.getnonfinitesamples();
+        r.ok = true;
+        return r;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const options opts = parseOptions(argc, argv);
+    const bool batch = opts.manifest != juce::File();
+    const int numJobs = (int) opts.jobs.size();
+    const int numThreads = opts.threads > 0 ? opts.threads : juce::SystemStats::getNumCpus();
+
+    // the parameter tree of the processor needs the message manager
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::TimeSliceThread prefetch("reverb-render prefetch");
+    prefetch.startThread();
+
+    // a single file uses all threads for its channels, a manifest gets one worker per thread
+    std::unique_ptr<juce::ThreadPool> pool;
+    if (! batch) pool = std::make_unique<juce::ThreadPool>(numThreads);
+    const int numWorkers = batch ? std::min(numThreads, std::max(1, numJobs)) : 1;
+    // created on this thread, the parameter tree of a processor starts a timer
+    std::vector<engine> engines((size_t) numWorkers);
+
+    std::unique_ptr<juce::FileOutputStream> log;
+    if (opts.log != juce::File()){
+        opts.log.deleteFile();
+        log = opts.log.createOutputStream();
+        if (log == nullptr){
+            std::fprintf(stderr, "could not write %s\n", opts.log.getFullPathName().toRawUTF8());
+            return 1;
+        }
+        *log << "job,worker,input,output,input_channels,output_channels,audio_seconds,setup_seconds,render_seconds,realtime_factor,peak_dbfs,status\n";
+    }
+
+    if (batch) std::printf("rendering %d jobs from %s on %d workers\n", numJobs, opts.manifest.getFullPathName().toRawUTF8(), numWorkers);
+    else std::printf("rendering %s to order %d on %d threads\n", opts.jobs[0].input.getFullPathName().toRawUTF8(), opts.jobs[0].order, numThreads);
+
+    std::atomic<int> nextJob {0};
+    int failedJobs = 0;
+    double totalAudioSeconds = 0.0;
+    std::mutex reportLock;
+    const auto start = std::chrono::steady_clock::now();
+
+    auto runWorker = [&](int worker){
+        for (int index = nextJob++; index < numJobs; index = nextJob++){
+            const job& j = opts.jobs[(size_t) index];
+            const result r = render(j, engines[(size_t) worker], opts, pool.get(), prefetch);
+            const double factor = r.renderSeconds > 0.0 ? r.audioSeconds / r.renderSeconds : 0.0;
+            const float peak = juce::Decibels::gainToDecibels(r.peak, -200.f);
+
+            const std::lock_guard<std::mutex> lock(reportLock);
+            if (r.ok){
+                totalAudioSeconds += r.audioSeconds;
+                std::printf("[%d/%d] worker %d: %s, %d -> %d channels, %.1f s of audio in %.2f s (setup %.2f s), realtime factor %.1fx, peak %.1f dBFS\n",
+                            index + 1, numJobs, worker, j.output.getFullPathName().toRawUTF8(), r.inputChannels, r.outputChannels, r.audioSeconds,
+                            r.renderSeconds, r.setupSeconds, factor, peak);
+                if (r.nonFiniteSamples > 0) std::printf("[%d/%d] warning: %llu NaN or infinite samples in the output\n", index + 1, numJobs, (unsigned long long) r.nonFiniteSamples);
+            }
+            else{
+                failedJobs++;
+                std::fprintf(stderr, "[%d/%d] worker %d: %s\n", index + 1, numJobs, worker, r.error.c_str());
+            }
+            std::fflush(stdout);
+            if (log != nullptr){
+                *log << (index + 1) << "," << worker << ",\"" << j.input.getFullPathName() << "\",\"" << j.output.getFullPathName() << "\","
+                     << r.inputChannels << "," << r.outputChannels << "," << juce::String(r.audioSeconds, 3) << "," << juce::String(r.setupSeconds, 3) << ","
+                     << juce::String(r.renderSeconds, 3) << "," << juce::String(factor, 2) << "," << juce::String(peak, 1) << "," << (r.ok ? "ok" : "failed") << "\n";
+                log->flush();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int worker = 1; worker < numWorkers; worker++) workers.emplace_back(runWorker, worker);
+    runWorker(0);
+    for (auto& worker : workers) worker.join();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (batch) std::printf("rendered %d of %d jobs, %.1f s of audio in %.2f s, realtime factor %.1fx\n", numJobs - failedJobs, numJobs,
+                           totalAudioSeconds, seconds, totalAudioSeconds / seconds);
+    prefetch.stopThread(1000);
+    return failedJobs > 0 ? 1 : 0;
+}
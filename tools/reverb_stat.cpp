@@ -0,0 +1,158 @@
+/**
+ * \file reverb_stat.cpp
+ *
+ * \brief Shows the live counters of all running standalone instances, like top.
+ *
+ * \details Every instance publishes its counters in a shared memory segment (see source/telemetry.h). reverb-stat maps the segments read-only and prints one line per instance: the processing load of the blocks as a fraction of their deadline (mean, 99th and 99.9th percentile, maximum), the deadline misses, the xruns of the audio device, the denormal and NaN/infinite output samples, the quality tier of the diffuse model (0 is the full model) and the flags R (resize in progress), F (freeze) and S (stale, the process is gone or stopped publishing). With --histogram the load histogram of every instance is shown as well, with --perf the hardware counters per block of the comb_filter bank, the allpass_filter chain and the mixing (see source/perf_counters.h).
+ *
+ * Usage: reverb-stat [-n iterations] [-d seconds] [-p pid] [--histogram] [--perf]
+ *
+ * \author Fares Schulz
+ *
+ * \date 2026/10/19
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "telemetry.h"
+
+namespace
+{
+    struct options{
+        /// number of refreshes, 0 runs until interrupted
+        int iterations = 0;
+        double delay = 1.0;
+        int pid = 0;
+        bool histogram = false;
+        bool perf = false;
+    };
+
+    /// an instance that did not publish for this long is marked stale
+    constexpr uint64_t staleAfterMs = 2000;
+
+    uint64_t nowMs(){
+        return (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    /// \brief Prints the histogram folded into a few load ranges
+    void printHistogram(const telemetry::counters& data){
+        const double edges[] = {0.0, 0.1, 0.25, 0.5, 0.75, 1.0, 2.0};
+        const int numRanges = (int) (sizeof(edges) / sizeof(edges[0]));
+        uint64_t counts[numRanges] = {};
+        uint64_t total = 0;
+        for (int bucket = 0; bucket < block_load_monitor::num_buckets; bucket++){
+            const double load = block_load_monitor::get_bucket_load(bucket);
+            int range = numRanges - 1;
+            while (range > 0 && load < edges[range]) range--;
+            counts[range] += data.load_histogram[bucket];
+            total += data.load_histogram[bucket];
+        }
+        for (int range = 0; range < numRanges; range++){
+            const double fraction = total > 0 ? (double) counts[range] / (double) total : 0.0;
+            char label[32];
+            if (range + 1 < numRanges) std::snprintf(label, sizeof(label), "%3.0f-%3.0f%%", 100.0 * edges[range], 100.0 * edges[range + 1]);
+            else std::snprintf(label, sizeof(label), "  >%3.0f%%", 100.0 * edges[range]);
+            std::printf("          %s %12llu %6.2f%% %s\n", label, (unsigned long long) counts[range], 100.0 * fraction,
+                        std::string((size_t) std::lround(40.0 * fraction), '#').c_str());
+        }
+    }
+
+    /// \brief Prints the hardware counters per block of every processing stage
+    void printPerfCounters(const telemetry::counters& data){
+        const perf_counters::statistics& perf = data.perf;
+        if (perf.blocks == 0){
+            std::printf("          no hardware counters, build with REVERB_PERF_COUNTERS and check /proc/sys/kernel/perf_event_paranoid\n");
+            return;
+        }
+        std::printf("          %-14s", "per block");
+        for (int e = 0; e < perf_counters::num_events; e++) std::printf(" %14s", perf_counters::get_event_name((perf_counters::event) e));
+        std::printf(" %6s\n", "IPC");
+        for (int s = 0; s < perf_counters::num_stages; s++){
+            std::printf("          %-14s", perf_counters::get_stage_name((perf_counters::stage) s));
+            for (int e = 0; e < perf_counters::num_events; e++){
+                if (perf.available & (1u << e)) std::printf(" %14.0f", (double) perf.counts[s][e] / (double) perf.blocks);
+                else std::printf(" %14s", "-");
+            }
+            const uint64_t cycles = perf.counts[s][perf_counters::cycles];
+            std::printf(" %6.2f\n", cycles > 0 ? (double) perf.counts[s][perf_counters::instructions] / (double) cycles : 0.0);
+        }
+    }
+
+    /// \brief Prints one refresh, returns the number of instances found
+    int printInstances(const options& opts){
+        std::printf("%7s %-24s %4s %6s %5s %-7s %6s %6s %6s %6s %8s %6s %8s %6s %4s %5s\n",
+                    "PID", "DEVICE", "CH", "RATE", "BLOCK", "KERNELS", "LOAD", "P99", "P99.9", "MAX", "MISSES", "XRUNS", "DENORM", "NAN", "TIER", "FLAGS");
+
+        int found = 0;
+        for (const std::string& name : telemetry::list_segments()){
+            const telemetry::segment* shared = telemetry::map(name);
+            if (shared == nullptr) continue;
+            telemetry::counters data;
+            const bool valid = telemetry::read(*shared, data);
+            telemetry::unmap(shared);
+            if (! valid || (opts.pid != 0 && data.pid != opts.pid)) continue;
+
+            // a segment stays behind when an instance is killed
+            const bool stale = kill(data.pid, 0) != 0 || nowMs() - data.update_time_ms > staleAfterMs;
+            std::string flags;
+            if (data.resize_in_progress) flags += 'R';
+            if (data.freeze) flags += 'F';
+            if (stale) flags += 'S';
+
+            data.device[sizeof(data.device) - 1] = '\0';
+            data.kernels[sizeof(data.kernels) - 1] = '\0';
+            std::printf("%7d %-24.24s %4d %6.0f %5d %-7s %5.1f%% %5.1f%% %5.1f%% %5.1f%% %8llu %6d %8llu %6llu %4d %5s\n",
+                        data.pid, data.device, data.active_channels, data.sample_rate, data.block_size, data.kernels,
+                        100.0 * data.load.mean, 100.0 * data.load.p99, 100.0 * data.load.p999, 100.0 * data.load.max,
+                        (unsigned long long) data.load.deadline_misses, data.xruns, (unsigned long long) data.denormal_samples,
+                        (unsigned long long) data.non_finite_samples, data.quality_tier, flags.c_str());
+            if (opts.histogram) printHistogram(data);
+            if (opts.perf) printPerfCounters(data);
+            found++;
+        }
+        return found;
+    }
+
+    options parseOptions(int argc, char* argv[]){
+        options opts;
+        for (int i = 1; i < argc; i++){
+            const std::string arg = argv[i];
+            if (arg == "-n" && i + 1 < argc) opts.iterations = std::max(0, std::atoi(argv[++i]));
+            else if (arg == "-d" && i + 1 < argc) opts.delay = std::max(0.1, std::atof(argv[++i]));
+            else if (arg == "-p" && i + 1 < argc) opts.pid = std::atoi(argv[++i]);
+            else if (arg == "--histogram") opts.histogram = true;
+            else if (arg == "--perf") opts.perf = true;
+            else{
+                std::fprintf(stderr, "usage: %s [-n iterations] [-d seconds] [-p pid] [--histogram] [--perf]\n", argv[0]);
+                std::exit(arg == "--help" ? 0 : 1);
+            }
+        }
+        return opts;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const options opts = parseOptions(argc, argv);
+    const bool terminal = isatty(STDOUT_FILENO);
+
+    for (int iteration = 0; opts.iterations == 0 || iteration < opts.iterations; iteration++){
+        if (iteration > 0) std::this_thread::sleep_for(std::chrono::duration<double>(opts.delay));
+        // clear the screen and start at the top
+        if (terminal) std::printf("\033[H\033[2J");
+        if (printInstances(opts) == 0) std::printf("no running instances found\n");
+        std::fflush(stdout);
+    }
+    return 0;
+}